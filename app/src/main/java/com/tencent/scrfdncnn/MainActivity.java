@@ -111,6 +111,8 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback
             }
         });
 
+        scrfdncnn.setTuneCachePath(getFilesDir().getAbsolutePath() + "/scrfd_tune.txt");
+
         reload();
     }
 
@@ -19,7 +19,56 @@ import android.view.Surface;
 
 public class SCRFDNcnn
 {
+    // option flags for loadModelWithOptions, keep in sync with SCRFDNetConfig in scrfd.h
+    public static final int OPT_FP16_PACKED = 1 << 0;
+    public static final int OPT_FP16_STORAGE = 1 << 1;
+    public static final int OPT_FP16_ARITHMETIC = 1 << 2;
+    public static final int OPT_PACKING_LAYOUT = 1 << 3;
+    public static final int OPT_WINOGRAD = 1 << 4;
+    public static final int OPT_SGEMM = 1 << 5;
+    public static final int OPT_LIGHTMODE = 1 << 6;
+    public static final int OPT_DEFAULT = (1 << 7) - 1;
+
+    public static final int LANDMARK_BY_AREA = 0;
+    public static final int LANDMARK_BY_PROB = 1;
+
     public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu);
+    // detthreads/lmkthreads 0 = big cpu count
+    public native boolean loadModelWithOptions(AssetManager mgr, int modelid, int cpugpu, int detflags, int detthreads, int lmkflags, int lmkthreads);
+    // autotune thread settings on loadModel and cache them in this file
+    public native boolean setTuneCachePath(String path);
+    // manual thread settings, powersave 0 = all cores 1 = little cores 2 = big cores
+    // both nets run on the inference thread bound to detpowersave, lmkpowersave is kept for the tune cache only
+    public native boolean setThreadConfig(int detthreads, int detpowersave, int lmkthreads, int lmkpowersave, int camerapowersave);
+    // only detect faces with long side in [minsize, maxsize] camera pixels, 0 = no limit
+    // stride heads outside the range are skipped
+    public native boolean setFaceSizeRange(int minsize, int maxsize);
+    // x y w h quads in camera frame pixels, null or empty include = whole frame
+    // detection runs only on the include crops, faces centered in exclude are dropped
+    public native boolean setRegions(int[] include, int[] exclude);
+    // limit 106-point landmark time per frame, 0 = no limit
+    // faces over budget keep last frame points or fall back to the 5 keypoints
+    public native boolean setLandmarkBudget(float budgetms, int priority);
+    // reuse last frame faces while the mean luma difference stays under threshold, 0 = off
+    // facethreshold applies around each known face, maxskip forces a run after that many skipped frames
+    public native boolean setMotionGate(float threshold, float facethreshold, int maxskip);
+    // preload the models on the ladder, cheapest first, and switch between them to keep detect within targetms
+    // the levels use the net options of the last loadModelWithOptions and share one landmark net
+    // loadModel turns it off again
+    public native boolean enableLatencyControl(AssetManager mgr, int[] modelids, int[] targetsizes, int cpugpu, float targetms);
+    // level, modelid, targetsize, targetms, lastms, emams, frames, stepups, stepdowns, overbudgetframes
+    // null when latency control is off
+    public native float[] getLatencyControlMetrics();
+    // per-stage latency in ms, 6 values per stage in this order
+    // nv21_repack crop_rotate rgb_convert detect_extract decode nms landmark draw window_post
+    // count mean p50 p90 p99 max, followed by the frames drops faces skips counters
+    public native float[] getMetrics();
+    public native boolean resetMetrics();
+    // write chrome trace json of recent pipeline events, false unless built with SCRFD_TRACE
+    public native boolean dumpTrace(String path);
+    // append per-frame results to a binary journal, see facerecord.h
+    public native boolean startRecording(String path);
+    public native boolean stopRecording();
     public native boolean openCamera(int facing);
     public native boolean closeCamera();
     public native boolean setOutputWindow(Surface surface);
@@ -0,0 +1,139 @@
+#include "autotune.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+
+static void thread_candidates(int powersave, std::vector<int>& candidates)
+{
+    candidates.clear();
+
+    int cpu_count = ncnn::get_cpu_thread_affinity_mask(powersave).num_enabled();
+    if (cpu_count == 0)
+        return;
+
+    for (int t = 1; t < cpu_count; t *= 2)
+    {
+        candidates.push_back(t);
+    }
+    candidates.push_back(cpu_count);
+}
+
+// fixed_powersave >= 0 tunes only the thread count on that core set
+static void tune_net(SCRFD& scrfd, bool landmark, int loops, int fixed_powersave, int& best_threads, int& best_powersave)
+{
+    double best_ms = 1e30;
+
+    for (int powersave = 0; powersave <= 2; powersave++)
+    {
+        if (fixed_powersave >= 0 && powersave != fixed_powersave)
+            continue;
+
+        std::vector<int> candidates;
+        thread_candidates(powersave, candidates);
+
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            const int num_threads = candidates[i];
+
+            double ms = landmark ? scrfd.benchmark_landmark(num_threads, powersave, loops) : scrfd.benchmark_detector(num_threads, powersave, loops);
+
+            if (ms < best_ms)
+            {
+                best_ms = ms;
+                best_threads = num_threads;
+                best_powersave = powersave;
+            }
+        }
+    }
+}
+
+int scrfd_autotune(SCRFD& scrfd, SCRFDConfig& config, int loops)
+{
+    config = scrfd.get_config();
+
+    tune_net(scrfd, false, loops, -1, config.detector.num_threads, config.detector.powersave);
+
+    // the landmark net runs on the thread bound to the detector cores, see SCRFD::bind_thread()
+    // a shared one is tuned with its owner
+    if (!scrfd.shares_landmark())
+        tune_net(scrfd, true, loops, config.detector.powersave, config.landmark.num_threads, config.landmark.powersave);
+
+    scrfd.set_threads(config.detector.num_threads, config.detector.powersave, config.landmark.num_threads, config.landmark.powersave);
+
+    return 0;
+}
+
+int load_tune_cache(const char* path, const char* key, SCRFDConfig& config)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return -1;
+
+    int ret = -1;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp))
+    {
+        char linekey[128];
+        int det_threads = 0;
+        int det_powersave = 0;
+        int lmk_threads = 0;
+        int lmk_powersave = 0;
+        int nscan = sscanf(line, "%127s %d %d %d %d", linekey, &det_threads, &det_powersave, &lmk_threads, &lmk_powersave);
+        if (nscan != 5 || strcmp(linekey, key) != 0)
+            continue;
+
+        config.detector.num_threads = det_threads;
+        config.detector.powersave = det_powersave;
+        config.landmark.num_threads = lmk_threads;
+        config.landmark.powersave = lmk_powersave;
+        ret = 0;
+    }
+
+    fclose(fp);
+
+    return ret;
+}
+
+int save_tune_cache(const char* path, const char* key, const SCRFDConfig& config)
+{
+    // keep the entries of other keys
+    std::vector<std::string> lines;
+    {
+        FILE* fp = fopen(path, "rb");
+        if (fp)
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), fp))
+            {
+                char linekey[128];
+                if (sscanf(line, "%127s", linekey) != 1 || strcmp(linekey, key) == 0)
+                    continue;
+
+                lines.push_back(line);
+            }
+
+            fclose(fp);
+        }
+    }
+
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return -1;
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        fputs(lines[i].c_str(), fp);
+    }
+
+    fprintf(fp, "%s %d %d %d %d\n", key, config.detector.num_threads, config.detector.powersave, config.landmark.num_threads, config.landmark.powersave);
+
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "scrfd.h"
+
+// benchmark thread count and core set candidates for the detector and the landmark net
+// of a loaded SCRFD on the current machine, writes the fastest into config
+// only the detector when the landmark net is shared, see SCRFD::share_landmark()
+int scrfd_autotune(SCRFD& scrfd, SCRFDConfig& config, int loops = 8);
+
+// tune results persisted as text, one "key det_threads det_powersave lmk_threads lmk_powersave" line per key
+// key identifies model and device, eg. "500m_kps_cpu_8"
+int load_tune_cache(const char* path, const char* key, SCRFDConfig& config);
+int save_tune_cache(const char* path, const char* key, const SCRFDConfig& config);
+
+#endif // AUTOTUNE_H
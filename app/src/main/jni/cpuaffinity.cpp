@@ -0,0 +1,69 @@
+#include "cpuaffinity.h"
+
+#if defined __ANDROID__ || defined __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "cpu.h"
+
+// last affinity applied from this thread, -1 = unknown
+static thread_local int g_thread_powersave = -1;
+static thread_local int g_team_powersave = -1;
+
+static const ncnn::CpuSet& resolve_affinity_mask(int powersave)
+{
+    const ncnn::CpuSet& mask = ncnn::get_cpu_thread_affinity_mask(powersave);
+    if (mask.num_enabled() == 0)
+        return ncnn::get_cpu_thread_affinity_mask(0);
+
+    return mask;
+}
+
+int set_inference_affinity(int powersave)
+{
+    if (powersave < 0 || powersave > 2)
+        return -1;
+
+    if (g_team_powersave != powersave)
+    {
+        int ret = ncnn::set_cpu_thread_affinity(resolve_affinity_mask(powersave));
+        if (ret != 0)
+            return ret;
+
+        g_team_powersave = powersave;
+        g_thread_powersave = powersave;
+        return 0;
+    }
+
+    // workers are already there, the calling thread may have moved
+    return set_current_thread_affinity(powersave);
+}
+
+int get_inference_affinity()
+{
+    return g_team_powersave;
+}
+
+int set_current_thread_affinity(int powersave)
+{
+    if (powersave < 0 || powersave > 2)
+        return -1;
+
+    if (g_thread_powersave == powersave)
+        return 0;
+
+#if defined __ANDROID__ || defined __linux__
+    const ncnn::CpuSet& mask = resolve_affinity_mask(powersave);
+
+    pid_t pid = syscall(SYS_gettid);
+    int ret = syscall(__NR_sched_setaffinity, pid, sizeof(cpu_set_t), &mask.cpu_set);
+    if (ret != 0)
+        return ret;
+#endif
+
+    g_thread_powersave = powersave;
+
+    return 0;
+}
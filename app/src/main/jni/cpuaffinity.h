@@ -0,0 +1,16 @@
+#ifndef CPUAFFINITY_H
+#define CPUAFFINITY_H
+
+// powersave 0 = all cores, 1 = little cores, 2 = big cores, same as ncnn::set_cpu_powersave
+// an empty core set, eg. little cores on a symmetric cpu, falls back to all cores
+
+// pin the calling thread and the ncnn openmp worker team
+int set_inference_affinity(int powersave);
+
+// powersave last applied by set_inference_affinity on the calling thread, -1 = never
+int get_inference_affinity();
+
+// pin only the calling thread, the openmp worker team keeps its affinity
+int set_current_thread_affinity(int powersave);
+
+#endif // CPUAFFINITY_H
@@ -0,0 +1,401 @@
+#include "facerecord.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "mat.h"
+
+// reads "FREC" in the file on a little endian writer
+static const uint32_t record_magic = 0x43455246;
+
+// journal grows by this much at a time
+static const size_t grow_size = 4 * 1024 * 1024;
+
+static size_t record_size(int face_count, int flags)
+{
+    size_t size = sizeof(FaceRecordHeader) + face_count * sizeof(FaceRecordFace);
+    if (flags & FACERECORD_HAS_LANDMARKS)
+        size += face_count * 106 * 2 * sizeof(unsigned short);
+
+    return (size + 7) / 8 * 8;
+}
+
+static uint32_t record_checksum(const unsigned char* record, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        // the checksum field itself counts as zero
+        const size_t field = offsetof(FaceRecordHeader, checksum);
+        const unsigned char byte = i >= field && i < field + sizeof(uint32_t) ? 0 : record[i];
+
+        hash = (hash ^ byte) * 16777619u;
+    }
+
+    return hash;
+}
+
+// walk the records after the file header, returns the end of the last valid one
+static size_t scan_records(const unsigned char* data, size_t size, std::vector<size_t>* offsets)
+{
+    size_t offset = sizeof(FaceRecordFileHeader);
+    while (offset + sizeof(FaceRecordHeader) <= size)
+    {
+        FaceRecordHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+
+        if (header.magic != record_magic)
+            break;
+
+        if (header.size != record_size(header.face_count, header.flags) || offset + header.size > size)
+            break;
+
+        // torn by a power loss, nothing after it is trusted either
+        if (header.checksum != record_checksum(data + offset, header.size))
+            break;
+
+        if (offsets)
+            offsets->push_back(offset);
+
+        offset += header.size;
+    }
+
+    return offset;
+}
+
+static bool check_file_header(const unsigned char* data, size_t size)
+{
+    if (size < sizeof(FaceRecordFileHeader))
+        return false;
+
+    FaceRecordFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    return memcmp(header.magic, "SCRFDREC", 8) == 0 && header.version == FACERECORD_VERSION;
+}
+
+FaceRecordWriter::FaceRecordWriter()
+{
+    fd = -1;
+    data = 0;
+    capacity = 0;
+    size = 0;
+}
+
+FaceRecordWriter::~FaceRecordWriter()
+{
+    close();
+}
+
+int FaceRecordWriter::open(const char* path)
+{
+    close();
+
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close();
+        return -1;
+    }
+
+    const size_t file_size = st.st_size;
+
+    if (file_size == 0)
+    {
+        if (remap(grow_size) != 0)
+        {
+            close();
+            return -1;
+        }
+
+        FaceRecordFileHeader header;
+        memcpy(header.magic, "SCRFDREC", 8);
+        header.version = FACERECORD_VERSION;
+        header.reserved = 0;
+        memcpy(data, &header, sizeof(header));
+
+        size = sizeof(header);
+        return 0;
+    }
+
+    if (remap(file_size) != 0 || !check_file_header(data, file_size))
+    {
+        close();
+        return -1;
+    }
+
+    size = scan_records(data, file_size, 0);
+
+    return 0;
+}
+
+void FaceRecordWriter::close()
+{
+    if (data)
+    {
+        munmap(data, capacity);
+        data = 0;
+    }
+
+    if (fd >= 0)
+    {
+        // drop the zero tail
+        if (size > 0)
+            ftruncate(fd, size);
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    capacity = 0;
+    size = 0;
+}
+
+int FaceRecordWriter::remap(size_t new_capacity)
+{
+    if (data)
+    {
+        munmap(data, capacity);
+        data = 0;
+        capacity = 0;
+    }
+
+    if (ftruncate(fd, new_capacity) != 0)
+        return -1;
+
+    void* ptr = mmap(0, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+        return -1;
+
+    data = (unsigned char*)ptr;
+    capacity = new_capacity;
+
+    return 0;
+}
+
+int FaceRecordWriter::append(uint64_t frame_id, int64_t timestamp_us, const FrameResult& result)
+{
+    if (fd < 0)
+        return -1;
+
+    const std::vector<FaceObject>& faceobjects = result.faceobjects;
+
+    const int face_count = std::min(result.face_count(), 65535);
+    const int flags = result.has_landmarks() ? FACERECORD_HAS_LANDMARKS : 0;
+    const size_t rsize = record_size(face_count, flags);
+
+    if (size + rsize > capacity)
+    {
+        size_t new_capacity = capacity + grow_size;
+        while (size + rsize > new_capacity)
+            new_capacity += grow_size;
+
+        if (remap(new_capacity) != 0)
+        {
+            // keep what is on disk
+            close();
+            return -1;
+        }
+    }
+
+    unsigned char* ptr = data + size;
+    memset(ptr, 0, rsize);
+
+    FaceRecordHeader header;
+    header.magic = record_magic;
+    header.size = (uint32_t)rsize;
+    header.frame_id = frame_id;
+    header.timestamp_us = timestamp_us;
+    header.face_count = (uint16_t)face_count;
+    header.flags = (uint16_t)flags;
+    header.checksum = 0;
+
+    unsigned char* faceptr = ptr + sizeof(FaceRecordHeader);
+    for (int i = 0; i < face_count; i++)
+    {
+        const FaceObject& obj = faceobjects[i];
+
+        FaceRecordFace face;
+        memset(&face, 0, sizeof(face));
+        face.rect[0] = obj.rect.x;
+        face.rect[1] = obj.rect.y;
+        face.rect[2] = obj.rect.width;
+        face.rect[3] = obj.rect.height;
+        face.prob = obj.prob;
+        for (int k = 0; k < 5; k++)
+        {
+            face.keypoints[k * 2] = obj.landmark[k].x;
+            face.keypoints[k * 2 + 1] = obj.landmark[k].y;
+        }
+        face.landmark_state = (uint8_t)obj.landmark_state;
+
+        memcpy(faceptr, &face, sizeof(face));
+        faceptr += sizeof(face);
+    }
+
+    if (flags & FACERECORD_HAS_LANDMARKS)
+    {
+        unsigned short* lmkptr = (unsigned short*)faceptr;
+        for (int i = 0; i < face_count * 106; i++)
+        {
+            lmkptr[0] = ncnn::float32_to_float16(result.landmarks[i].x);
+            lmkptr[1] = ncnn::float32_to_float16(result.landmarks[i].y);
+            lmkptr += 2;
+        }
+    }
+
+    // header after the payload, so a reader of this mapping finds a record only once it is complete
+    // the order pages reach the disk in is covered by the checksum, see FaceRecordWriter
+    memcpy(ptr, &header, sizeof(header));
+
+    header.checksum = record_checksum(ptr, rsize);
+    memcpy(ptr + offsetof(FaceRecordHeader, checksum), &header.checksum, sizeof(header.checksum));
+
+    size += rsize;
+
+    return 0;
+}
+
+int FaceRecordWriter::sync()
+{
+    if (!data)
+        return -1;
+
+    return msync(data, size, MS_ASYNC);
+}
+
+FaceRecordReader::FaceRecordReader()
+{
+    fd = -1;
+    data = 0;
+    size = 0;
+}
+
+FaceRecordReader::~FaceRecordReader()
+{
+    close();
+}
+
+int FaceRecordReader::open(const char* path)
+{
+    close();
+
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close();
+        return -1;
+    }
+
+    size = st.st_size;
+
+    void* ptr = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED)
+    {
+        close();
+        return -1;
+    }
+
+    data = (const unsigned char*)ptr;
+
+    if (!check_file_header(data, size))
+    {
+        close();
+        return -1;
+    }
+
+    scan_records(data, size, &offsets);
+
+    return 0;
+}
+
+void FaceRecordReader::close()
+{
+    if (data)
+    {
+        munmap((void*)data, size);
+        data = 0;
+    }
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+
+    size = 0;
+    offsets.clear();
+}
+
+int FaceRecordReader::read(int index, FaceRecordFrame& frame) const
+{
+    if (index < 0 || index >= (int)offsets.size())
+        return -1;
+
+    const unsigned char* ptr = data + offsets[index];
+
+    FaceRecordHeader header;
+    memcpy(&header, ptr, sizeof(header));
+
+    frame.frame_id = header.frame_id;
+    frame.timestamp_us = header.timestamp_us;
+
+    const int face_count = header.face_count;
+
+    FrameResult& result = frame.result;
+
+    result.faceobjects.resize(face_count);
+    const unsigned char* faceptr = ptr + sizeof(FaceRecordHeader);
+    for (int i = 0; i < face_count; i++)
+    {
+        FaceRecordFace face;
+        memcpy(&face, faceptr, sizeof(face));
+        faceptr += sizeof(face);
+
+        FaceObject& obj = result.faceobjects[i];
+        obj.rect.x = face.rect[0];
+        obj.rect.y = face.rect[1];
+        obj.rect.width = face.rect[2];
+        obj.rect.height = face.rect[3];
+        obj.prob = face.prob;
+        obj.landmark_state = face.landmark_state;
+        for (int k = 0; k < 5; k++)
+        {
+            obj.landmark[k].x = face.keypoints[k * 2];
+            obj.landmark[k].y = face.keypoints[k * 2 + 1];
+        }
+    }
+
+    result.landmarks.clear();
+    if (header.flags & FACERECORD_HAS_LANDMARKS)
+    {
+        result.landmarks.resize(face_count * 106);
+
+        const unsigned char* lmkptr = faceptr;
+        for (int i = 0; i < face_count * 106; i++)
+        {
+            unsigned short xy[2];
+            memcpy(xy, lmkptr, sizeof(xy));
+            lmkptr += sizeof(xy);
+
+            result.landmarks[i].x = ncnn::float16_to_float32(xy[0]);
+            result.landmarks[i].y = ncnn::float16_to_float32(xy[1]);
+        }
+    }
+
+    return 0;
+}
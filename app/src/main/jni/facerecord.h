@@ -0,0 +1,125 @@
+#ifndef FACERECORD_H
+#define FACERECORD_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "scrfd.h"
+
+// binary journal of per-frame detection results
+//
+// file    = FaceRecordFileHeader, record, record, ...
+// record  = FaceRecordHeader
+//           face_count x FaceRecordFace
+//           face_count x 106 x 2 fp16 landmarks, when FACERECORD_HAS_LANDMARKS is set
+//           zero padding to 8 bytes
+// checksum is fnv-1a over the whole record with the checksum field zero, readers stop at the first mismatch
+// values are raw structs in the writer's native byte order, little endian on every android abi and on x86
+// there is no byte swapping, read a journal on a machine of the same byte order
+// record size includes the header
+
+#define FACERECORD_VERSION 3
+
+enum
+{
+    FACERECORD_HAS_LANDMARKS = 1 << 0
+};
+
+struct FaceRecordFileHeader
+{
+    char magic[8]; // "SCRFDREC"
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct FaceRecordHeader
+{
+    uint32_t magic; // 'FREC'
+    uint32_t size;
+    uint64_t frame_id;
+    int64_t timestamp_us;
+    uint16_t face_count;
+    uint16_t flags;
+    uint32_t checksum;
+};
+
+struct FaceRecordFace
+{
+    float rect[4]; // x y w h
+    float prob;
+    float keypoints[10]; // 5 x (x y)
+    uint8_t landmark_state; // FaceObject::LANDMARK_*, the 106 points of a fallback face are zero and not landmarks
+    uint8_t reserved[3];
+};
+
+struct FaceRecordFrame
+{
+    uint64_t frame_id;
+    int64_t timestamp_us;
+    // landmarks are empty when the record has none
+    FrameResult result;
+};
+
+// appends records to a memory-mapped file that grows in chunks
+// the unused tail is zero so reading stops after the last appended record
+// a process crash loses nothing already appended, the page cache still holds the shared mapping
+// after a power loss or os crash pages reach the disk in any order, a torn record at the end
+// fails its checksum and reading stops before it, sync() narrows how much is lost
+class FaceRecordWriter
+{
+public:
+    FaceRecordWriter();
+    ~FaceRecordWriter();
+
+    // existing journals are appended to
+    int open(const char* path);
+    void close();
+
+    bool is_open() const { return fd >= 0; }
+
+    // landmarks are quantized to fp16
+    int append(uint64_t frame_id, int64_t timestamp_us, const FrameResult& result);
+
+    // flush written records to disk
+    int sync();
+
+private:
+    FaceRecordWriter(const FaceRecordWriter&);
+    FaceRecordWriter& operator=(const FaceRecordWriter&);
+
+    int remap(size_t new_capacity);
+
+    int fd;
+    unsigned char* data;
+    size_t capacity;
+    size_t size;
+};
+
+// random access to the records of a journal by frame index
+class FaceRecordReader
+{
+public:
+    FaceRecordReader();
+    ~FaceRecordReader();
+
+    int open(const char* path);
+    void close();
+
+    int frame_count() const { return (int)offsets.size(); }
+
+    int read(int index, FaceRecordFrame& frame) const;
+
+private:
+    FaceRecordReader(const FaceRecordReader&);
+    FaceRecordReader& operator=(const FaceRecordReader&);
+
+    int fd;
+    const unsigned char* data;
+    size_t size;
+    std::vector<size_t> offsets;
+};
+
+#endif // FACERECORD_H
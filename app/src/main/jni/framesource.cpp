@@ -0,0 +1,385 @@
+#include "framesource.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "mat.h"
+
+#include "metrics.h"
+#include "pixelconvert.h"
+#include "rotation.h"
+#include "trace.h"
+
+FrameSource::FrameSource()
+{
+    camera_facing = 0;
+    camera_orientation = 0;
+}
+
+FrameSource::~FrameSource()
+{
+}
+
+void FrameSource::on_image(const cv::Mat& rgb) const
+{
+}
+
+void FrameSource::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
+{
+    // rotate nv21
+    int w = 0;
+    int h = 0;
+    int rotate_type = 0;
+    {
+        if (camera_orientation == 0)
+        {
+            w = nv21_width;
+            h = nv21_height;
+            rotate_type = camera_facing == 0 ? 2 : 1;
+        }
+        if (camera_orientation == 90)
+        {
+            w = nv21_height;
+            h = nv21_width;
+            rotate_type = camera_facing == 0 ? 5 : 6;
+        }
+        if (camera_orientation == 180)
+        {
+            w = nv21_width;
+            h = nv21_height;
+            rotate_type = camera_facing == 0 ? 4 : 3;
+        }
+        if (camera_orientation == 270)
+        {
+            w = nv21_height;
+            h = nv21_width;
+            rotate_type = camera_facing == 0 ? 7 : 8;
+        }
+    }
+
+    cv::Mat nv21_rotated(h + h / 2, w, CV_8UC1);
+    ncnn::kanna_rotate_yuv420sp(nv21, nv21_width, nv21_height, nv21_rotated.data, w, h, rotate_type);
+
+    // nv21_rotated to rgb
+    cv::Mat rgb(h, w, CV_8UC3);
+    ncnn::yuv420sp2rgb(nv21_rotated.data, w, h, rgb.data);
+
+    on_image(rgb);
+}
+
+void frame_geometry(int nv21_width, int nv21_height, int camera_facing, int camera_orientation, int accelerometer_orientation, int window_width, int window_height, FrameGeometry& g)
+{
+    int nv21_roi_x = 0;
+    int nv21_roi_y = 0;
+    int nv21_roi_w = 0;
+    int nv21_roi_h = 0;
+    int roi_x = 0;
+    int roi_y = 0;
+    int roi_w = 0;
+    int roi_h = 0;
+    int rotate_type = 0;
+    int render_w = 0;
+    int render_h = 0;
+    int render_rotate_type = 0;
+    {
+        int win_w = window_width;
+        int win_h = window_height;
+
+        if (accelerometer_orientation == 90 || accelerometer_orientation == 270)
+        {
+            std::swap(win_w, win_h);
+        }
+
+        const int final_orientation = (camera_orientation + accelerometer_orientation) % 360;
+
+        if (final_orientation == 0 || final_orientation == 180)
+        {
+            if (win_w * nv21_height > win_h * nv21_width)
+            {
+                roi_w = nv21_width;
+                roi_h = (nv21_width * win_h / win_w) / 2 * 2;
+                roi_x = 0;
+                roi_y = ((nv21_height - roi_h) / 2) / 2 * 2;
+            }
+            else
+            {
+                roi_h = nv21_height;
+                roi_w = (nv21_height * win_w / win_h) / 2 * 2;
+                roi_x = ((nv21_width - roi_w) / 2) / 2 * 2;
+                roi_y = 0;
+            }
+
+            nv21_roi_x = roi_x;
+            nv21_roi_y = roi_y;
+            nv21_roi_w = roi_w;
+            nv21_roi_h = roi_h;
+        }
+        if (final_orientation == 90 || final_orientation == 270)
+        {
+            if (win_w * nv21_width > win_h * nv21_height)
+            {
+                roi_w = nv21_height;
+                roi_h = (nv21_height * win_h / win_w) / 2 * 2;
+                roi_x = 0;
+                roi_y = ((nv21_width - roi_h) / 2) / 2 * 2;
+            }
+            else
+            {
+                roi_h = nv21_width;
+                roi_w = (nv21_width * win_w / win_h) / 2 * 2;
+                roi_x = ((nv21_height - roi_w) / 2) / 2 * 2;
+                roi_y = 0;
+            }
+
+            nv21_roi_x = roi_y;
+            nv21_roi_y = roi_x;
+            nv21_roi_w = roi_h;
+            nv21_roi_h = roi_w;
+        }
+
+        if (camera_facing == 0)
+        {
+            if (camera_orientation == 0 && accelerometer_orientation == 0)
+            {
+                rotate_type = 2;
+            }
+            if (camera_orientation == 0 && accelerometer_orientation == 90)
+            {
+                rotate_type = 7;
+            }
+            if (camera_orientation == 0 && accelerometer_orientation == 180)
+            {
+                rotate_type = 4;
+            }
+            if (camera_orientation == 0 && accelerometer_orientation == 270)
+            {
+                rotate_type = 5;
+            }
+            if (camera_orientation == 90 && accelerometer_orientation == 0)
+            {
+                rotate_type = 5;
+            }
+            if (camera_orientation == 90 && accelerometer_orientation == 90)
+            {
+                rotate_type = 2;
+            }
+            if (camera_orientation == 90 && accelerometer_orientation == 180)
+            {
+                rotate_type = 7;
+            }
+            if (camera_orientation == 90 && accelerometer_orientation == 270)
+            {
+                rotate_type = 4;
+            }
+            if (camera_orientation == 180 && accelerometer_orientation == 0)
+            {
+                rotate_type = 4;
+            }
+            if (camera_orientation == 180 && accelerometer_orientation == 90)
+            {
+                rotate_type = 5;
+            }
+            if (camera_orientation == 180 && accelerometer_orientation == 180)
+            {
+                rotate_type = 2;
+            }
+            if (camera_orientation == 180 && accelerometer_orientation == 270)
+            {
+                rotate_type = 7;
+            }
+            if (camera_orientation == 270 && accelerometer_orientation == 0)
+            {
+                rotate_type = 7;
+            }
+            if (camera_orientation == 270 && accelerometer_orientation == 90)
+            {
+                rotate_type = 4;
+            }
+            if (camera_orientation == 270 && accelerometer_orientation == 180)
+            {
+                rotate_type = 5;
+            }
+            if (camera_orientation == 270 && accelerometer_orientation == 270)
+            {
+                rotate_type = 2;
+            }
+        }
+        else
+        {
+            if (final_orientation == 0)
+            {
+                rotate_type = 1;
+            }
+            if (final_orientation == 90)
+            {
+                rotate_type = 6;
+            }
+            if (final_orientation == 180)
+            {
+                rotate_type = 3;
+            }
+            if (final_orientation == 270)
+            {
+                rotate_type = 8;
+            }
+        }
+
+        if (accelerometer_orientation == 0)
+        {
+            render_w = roi_w;
+            render_h = roi_h;
+            render_rotate_type = 1;
+        }
+        if (accelerometer_orientation == 90)
+        {
+            render_w = roi_h;
+            render_h = roi_w;
+            render_rotate_type = 8;
+        }
+        if (accelerometer_orientation == 180)
+        {
+            render_w = roi_w;
+            render_h = roi_h;
+            render_rotate_type = 3;
+        }
+        if (accelerometer_orientation == 270)
+        {
+            render_w = roi_h;
+            render_h = roi_w;
+            render_rotate_type = 6;
+        }
+    }
+
+    g.nv21_roi_x = nv21_roi_x;
+    g.nv21_roi_y = nv21_roi_y;
+    g.nv21_roi_w = nv21_roi_w;
+    g.nv21_roi_h = nv21_roi_h;
+    g.roi_w = roi_w;
+    g.roi_h = roi_h;
+    g.rotate_type = rotate_type;
+    g.render_w = render_w;
+    g.render_h = render_h;
+    g.render_rotate_type = render_rotate_type;
+    g.window_rotate_type = rotate_type_compose(rotate_type, render_rotate_type);
+}
+
+void frame_to_sensor_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g, cv::Mat& rgb)
+{
+    const int nv21_roi_x = g.nv21_roi_x;
+    const int nv21_roi_y = g.nv21_roi_y;
+    const int nv21_roi_w = g.nv21_roi_w;
+    const int nv21_roi_h = g.nv21_roi_h;
+
+    MetricTimer timer(METRIC_RGB_CONVERT);
+
+    rgb.create(nv21_roi_h, nv21_roi_w, CV_8UC3);
+
+    if (nv21_roi_w == nv21_width && nv21_roi_h == nv21_height)
+    {
+        ncnn::yuv420sp2rgb(nv21, nv21_width, nv21_height, rgb.data);
+        return;
+    }
+
+    // crop nv21, plain row copies
+    cv::Mat nv21_crop(nv21_roi_h + nv21_roi_h / 2, nv21_roi_w, CV_8UC1);
+    {
+        const unsigned char* srcY = nv21 + nv21_roi_y * nv21_width + nv21_roi_x;
+        unsigned char* dstY = nv21_crop.data;
+        for (int y = 0; y < nv21_roi_h; y++)
+        {
+            memcpy(dstY, srcY, nv21_roi_w);
+            srcY += nv21_width;
+            dstY += nv21_roi_w;
+        }
+
+        const unsigned char* srcUV = nv21 + nv21_width * nv21_height + nv21_roi_y * nv21_width / 2 + nv21_roi_x;
+        unsigned char* dstUV = nv21_crop.data + nv21_roi_w * nv21_roi_h;
+        for (int y = 0; y < nv21_roi_h / 2; y++)
+        {
+            memcpy(dstUV, srcUV, nv21_roi_w);
+            srcUV += nv21_width;
+            dstUV += nv21_roi_w;
+        }
+    }
+
+    ncnn::yuv420sp2rgb(nv21_crop.data, nv21_roi_w, nv21_roi_h, rgb.data);
+}
+
+void frame_to_upright(const cv::Mat& sensor_rgb, const FrameGeometry& g, cv::Mat& rgb)
+{
+    MetricTimer timer(METRIC_CROP_ROTATE);
+
+    rgb.create(g.roi_h, g.roi_w, CV_8UC3);
+    ncnn::kanna_rotate_c3(sensor_rgb.data, g.nv21_roi_w, g.nv21_roi_h, rgb.data, g.roi_w, g.roi_h, g.rotate_type);
+}
+
+void frame_to_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g, cv::Mat& rgb)
+{
+    cv::Mat sensor_rgb;
+    frame_to_sensor_rgb(nv21, nv21_width, nv21_height, g, sensor_rgb);
+    frame_to_upright(sensor_rgb, g, rgb);
+}
+
+void frame_to_window(const cv::Mat& sensor_rgb, const FrameGeometry& g, cv::Mat& rgb_render)
+{
+    if (g.window_rotate_type == 1)
+    {
+        rgb_render = sensor_rgb;
+        return;
+    }
+
+    MetricTimer timer(METRIC_CROP_ROTATE);
+
+    rgb_render.create(g.render_h, g.render_w, CV_8UC3);
+    ncnn::kanna_rotate_c3(sensor_rgb.data, g.nv21_roi_w, g.nv21_roi_h, rgb_render.data, g.render_w, g.render_h, g.window_rotate_type);
+}
+
+void FrameSource::on_image_luma(const unsigned char* y, int width, int height, int stride, int rotate_type) const
+{
+}
+
+void FrameSource::on_image_sensor(const cv::Mat& rgb, int rotate_type) const
+{
+}
+
+void FrameSource::on_image_render(cv::Mat& rgb, int render_rotate_type) const
+{
+}
+
+unsigned char* FrameSource::lock_window(int width, int height, int* stride) const
+{
+    return 0;
+}
+
+void FrameSource::unlock_window() const
+{
+}
+
+void FrameSource::on_image_window(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g) const
+{
+    on_image_luma(nv21 + g.nv21_roi_y * nv21_width + g.nv21_roi_x, g.nv21_roi_w, g.nv21_roi_h, nv21_width, g.rotate_type);
+
+    // detect in sensor orientation, one rotation straight to the window for drawing
+    cv::Mat sensor_rgb;
+    frame_to_sensor_rgb(nv21, nv21_width, nv21_height, g, sensor_rgb);
+
+    on_image_sensor(sensor_rgb, g.rotate_type);
+
+    cv::Mat rgb_render;
+    frame_to_window(sensor_rgb, g, rgb_render);
+
+    on_image_render(rgb_render, g.render_rotate_type);
+
+    MetricTimer window_timer(METRIC_WINDOW_POST);
+    SCRFD_TRACE_SCOPE("window_post");
+
+    int stride = 0;
+    unsigned char* rgba = lock_window(g.render_w, g.render_h, &stride);
+    if (rgba)
+    {
+        rgb_to_rgba(rgb_render.data, g.render_w, g.render_h, (int)rgb_render.step, rgba, stride);
+    }
+
+    unlock_window();
+}
@@ -0,0 +1,85 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <opencv2/core/core.hpp>
+
+struct FrameGeometry;
+
+// a producer of nv21 frames in sensor orientation, the camera or a file replay
+// frames arrive on the source's own thread through on_image()
+class FrameSource
+{
+public:
+    FrameSource();
+    virtual ~FrameSource();
+
+    // facing 0=front 1=back
+    virtual int open(int camera_facing = 0) = 0;
+    virtual void close() = 0;
+
+    // upright rgb, called by the default nv21 on_image
+    virtual void on_image(const cv::Mat& rgb) const;
+
+    virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
+
+    // hooks of on_image_window()
+    // luma of the roi in sensor orientation, rotate_type turns it upright, called first
+    virtual void on_image_luma(const unsigned char* y, int width, int height, int stride, int rotate_type) const;
+
+    // rgb of the roi in sensor orientation for detection, see SCRFD::detect() with rotate_type
+    virtual void on_image_sensor(const cv::Mat& rgb, int rotate_type) const;
+
+    // rgb in window orientation for drawing, the only full frame rotation
+    // render_rotate_type turns the upright frame into it, see SCRFD::draw_overlay()
+    virtual void on_image_render(cv::Mat& rgb, int render_rotate_type) const;
+
+    // rgba destination of width x height for the window frame, 0 skips the copy
+    // unlock_window() follows every lock_window()
+    virtual unsigned char* lock_window(int width, int height, int* stride) const;
+    virtual void unlock_window() const;
+
+protected:
+    // the window pipeline of NdkCameraWindow and ReplayWindow, they differ only in lock_window()
+    // luma, sensor rgb for detection, rgb in window orientation for drawing, then rgba
+    void on_image_window(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g) const;
+
+public:
+    int camera_facing;
+    int camera_orientation;
+};
+
+// how NdkCameraWindow maps a sensor frame onto the output window
+// the nv21 roi matching the window aspect, its rotation to upright and the rotation back to the window
+struct FrameGeometry
+{
+    int nv21_roi_x;
+    int nv21_roi_y;
+    int nv21_roi_w;
+    int nv21_roi_h;
+    int roi_w;
+    int roi_h;
+    int rotate_type;
+    int render_w;
+    int render_h;
+    int render_rotate_type;
+    // rotate_type then render_rotate_type in one, sensor roi straight to the window
+    int window_rotate_type;
+};
+
+// accelerometer_orientation = device rotation 0 90 180 270
+void frame_geometry(int nv21_width, int nv21_height, int camera_facing, int camera_orientation, int accelerometer_orientation, int window_width, int window_height, FrameGeometry& g);
+
+// crop the roi and convert to rgb, still in sensor orientation, nv21_roi_w x nv21_roi_h
+// SCRFD::detect() takes it as is with g.rotate_type
+void frame_to_sensor_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g, cv::Mat& rgb);
+
+// rotate sensor rgb upright, roi_w x roi_h
+void frame_to_upright(const cv::Mat& sensor_rgb, const FrameGeometry& g, cv::Mat& rgb);
+
+// crop, convert and rotate the roi upright
+void frame_to_rgb(const unsigned char* nv21, int nv21_width, int nv21_height, const FrameGeometry& g, cv::Mat& rgb);
+
+// rotate sensor rgb straight to window orientation, render_w x render_h, shares the data when window_rotate_type is 1
+void frame_to_window(const cv::Mat& sensor_rgb, const FrameGeometry& g, cv::Mat& rgb_render);
+
+#endif // FRAMESOURCE_H
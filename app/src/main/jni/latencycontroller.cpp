@@ -0,0 +1,145 @@
+#include "latencycontroller.h"
+
+// weight of the newest sample in the moving average
+static const float ema_alpha = 0.2f;
+
+LatencyController::LatencyController()
+{
+    current = 0;
+
+    target_ms = 33.f;
+    low_ratio = 0.6f;
+    high_ratio = 1.f;
+    settle_frames = 15;
+
+    last_ms = 0.f;
+    ema_ms = 0.f;
+    over_count = 0;
+    under_count = 0;
+    cooldown = 0;
+
+    frames = 0;
+    step_ups = 0;
+    step_downs = 0;
+    over_budget_frames = 0;
+}
+
+void LatencyController::set_levels(const std::vector<LatencyLevel>& _levels, int start_level)
+{
+    levels = _levels;
+    level_ema_ms.assign(levels.size(), 0.f);
+    level_ema_frame.assign(levels.size(), 0);
+
+    current = 0;
+    if (start_level >= 0 && start_level < (int)levels.size())
+        current = start_level;
+
+    ema_ms = 0.f;
+    over_count = 0;
+    under_count = 0;
+    cooldown = settle_frames;
+}
+
+void LatencyController::set_target(float _target_ms)
+{
+    target_ms = _target_ms;
+}
+
+void LatencyController::set_hysteresis(float _low_ratio, float _high_ratio, int _settle_frames)
+{
+    low_ratio = _low_ratio;
+    high_ratio = _high_ratio;
+    settle_frames = _settle_frames;
+}
+
+int LatencyController::update(float detect_ms)
+{
+    if (levels.empty())
+        return 0;
+
+    frames++;
+    last_ms = detect_ms;
+
+    if (detect_ms > target_ms)
+        over_budget_frames++;
+
+    ema_ms = ema_ms == 0.f ? detect_ms : ema_ms + ema_alpha * (detect_ms - ema_ms);
+    level_ema_ms[current] = ema_ms;
+    level_ema_frame[current] = frames;
+
+    if (cooldown > 0)
+    {
+        cooldown--;
+        return current;
+    }
+
+    if (ema_ms > target_ms * high_ratio)
+    {
+        over_count++;
+        under_count = 0;
+    }
+    else if (ema_ms < target_ms * low_ratio)
+    {
+        under_count++;
+        over_count = 0;
+    }
+    else
+    {
+        over_count = 0;
+        under_count = 0;
+    }
+
+    if (over_count >= settle_frames && current > 0)
+    {
+        switch_level(current - 1);
+        step_downs++;
+    }
+    else if (under_count >= settle_frames * 2 && current + 1 < (int)levels.size())
+    {
+        // do not go back to a level that was recently measured over budget
+        // an old measurement expires, eg. it was taken while the device was throttled
+        const int next = current + 1;
+        if (level_ema_ms[next] == 0.f || level_ema_expired(next) || level_ema_ms[next] <= target_ms * high_ratio)
+        {
+            switch_level(current + 1);
+            step_ups++;
+        }
+    }
+
+    return current;
+}
+
+void LatencyController::switch_level(int new_level)
+{
+    current = new_level;
+
+    // restart the average from what we know about the new level, from scratch when that is too old
+    if (level_ema_expired(current))
+        level_ema_ms[current] = 0.f;
+
+    ema_ms = level_ema_ms[current];
+    over_count = 0;
+    under_count = 0;
+    cooldown = settle_frames;
+}
+
+bool LatencyController::level_ema_expired(int level) const
+{
+    return level_ema_ms[level] != 0.f && frames - level_ema_frame[level] >= settle_frames * 8;
+}
+
+LatencyControllerMetrics LatencyController::metrics() const
+{
+    LatencyControllerMetrics m;
+    m.level = current;
+    m.modelid = levels.empty() ? -1 : levels[current].modelid;
+    m.target_size = levels.empty() ? 0 : levels[current].target_size;
+    m.target_ms = target_ms;
+    m.last_ms = last_ms;
+    m.ema_ms = ema_ms;
+    m.frames = frames;
+    m.step_ups = step_ups;
+    m.step_downs = step_downs;
+    m.over_budget_frames = over_budget_frames;
+    return m;
+}
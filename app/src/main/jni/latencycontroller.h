@@ -0,0 +1,86 @@
+#ifndef LATENCYCONTROLLER_H
+#define LATENCYCONTROLLER_H
+
+#include <vector>
+
+// one detector setting the controller can pick
+struct LatencyLevel
+{
+    int modelid;     // index into modeltypes[] in scrfdncnn.cpp
+    int target_size; // SCRFDConfig::target_size
+};
+
+struct LatencyControllerMetrics
+{
+    int level;
+    int modelid;
+    int target_size;
+    float target_ms;
+    float last_ms;
+    float ema_ms;
+    int frames;
+    int step_ups;
+    int step_downs;
+    int over_budget_frames;
+};
+
+// steps through levels ordered from cheapest to most expensive to keep
+// the measured detect time within a target, with hysteresis so that
+// one slow frame does not cause a switch
+class LatencyController
+{
+public:
+    LatencyController();
+
+    // levels must be ordered from cheapest to most expensive
+    void set_levels(const std::vector<LatencyLevel>& levels, int start_level = 0);
+
+    void set_target(float target_ms);
+
+    // step down when the average goes over target_ms * high_ratio,
+    // step up when it stays under target_ms * low_ratio, with settle_frames
+    // consecutive frames required and a cooldown of settle_frames after a switch
+    void set_hysteresis(float low_ratio, float high_ratio, int settle_frames);
+
+    // feed the measured detect time of the last frame, returns the level for the next frame
+    int update(float detect_ms);
+
+    int level() const { return current; }
+    const LatencyLevel& current_level() const { return levels[current]; }
+    int level_count() const { return (int)levels.size(); }
+
+    LatencyControllerMetrics metrics() const;
+
+private:
+    void switch_level(int new_level);
+
+    // the average of a level not run for settle_frames * 8 frames says nothing about it any more
+    bool level_ema_expired(int level) const;
+
+    std::vector<LatencyLevel> levels;
+
+    // last known average of each level, 0 = never measured
+    std::vector<float> level_ema_ms;
+    // frames count when level_ema_ms was last updated
+    std::vector<int> level_ema_frame;
+
+    int current;
+
+    float target_ms;
+    float low_ratio;
+    float high_ratio;
+    int settle_frames;
+
+    float last_ms;
+    float ema_ms;
+    int over_count;
+    int under_count;
+    int cooldown;
+
+    int frames;
+    int step_ups;
+    int step_downs;
+    int over_budget_frames;
+};
+
+#endif // LATENCYCONTROLLER_H
@@ -0,0 +1,188 @@
+#include "metrics.h"
+
+#include <atomic>
+
+// log2 buckets over microseconds, each octave split in 4
+#define METRIC_BUCKETS 128
+
+struct StageHistogram
+{
+    std::atomic<uint32_t> buckets[METRIC_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_us;
+    std::atomic<uint32_t> max_us;
+};
+
+static StageHistogram g_stages[METRIC_STAGE_COUNT];
+static std::atomic<int64_t> g_counters[METRIC_COUNTER_COUNT];
+
+static const char* stage_names[METRIC_STAGE_COUNT] =
+{
+    "nv21_repack",
+    "crop_rotate",
+    "rgb_convert",
+    "detect_extract",
+    "decode",
+    "nms",
+    "landmark",
+    "draw",
+    "window_post"
+};
+
+static const char* counter_names[METRIC_COUNTER_COUNT] =
+{
+    "frames",
+    "drops",
+    "faces",
+    "skips"
+};
+
+static int bucket_index(uint32_t us)
+{
+    if (us < 4)
+        return us;
+
+    const int msb = 31 - __builtin_clz(us);
+    const int sub = (us >> (msb - 2)) & 3;
+    const int index = 4 + (msb - 2) * 4 + sub;
+    return index < METRIC_BUCKETS ? index : METRIC_BUCKETS - 1;
+}
+
+// bucket midpoint in us
+static double bucket_value(int index)
+{
+    if (index < 4)
+        return index;
+
+    const int msb = (index - 4) / 4 + 2;
+    const int sub = (index - 4) % 4;
+    const double width = (double)(1u << (msb - 2));
+    return (double)(1u << msb) + sub * width + width * 0.5;
+}
+
+void metrics_record(int stage, double ms)
+{
+    StageHistogram& h = g_stages[stage];
+
+    const uint32_t us = ms > 0 ? (uint32_t)(ms * 1000) : 0;
+
+    h.buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum_us.fetch_add(us, std::memory_order_relaxed);
+
+    uint32_t max_us = h.max_us.load(std::memory_order_relaxed);
+    while (us > max_us && !h.max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+void metrics_add(int counter, int64_t value)
+{
+    g_counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+static float percentile(const uint32_t* buckets, uint64_t count, double q)
+{
+    const uint64_t rank = (uint64_t)(count * q);
+
+    uint64_t seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+            return bucket_value(i) / 1000;
+    }
+
+    return bucket_value(METRIC_BUCKETS - 1) / 1000;
+}
+
+void metrics_snapshot(MetricsSnapshot& snapshot)
+{
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++)
+    {
+        const StageHistogram& h = g_stages[s];
+
+        // buckets are read one by one, count is taken from them so percentiles stay consistent
+        uint32_t buckets[METRIC_BUCKETS];
+        uint64_t count = 0;
+        for (int i = 0; i < METRIC_BUCKETS; i++)
+        {
+            buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+
+        MetricStageSummary& summary = snapshot.stages[s];
+        summary.count = count;
+        if (count == 0)
+        {
+            summary.mean = 0.f;
+            summary.p50 = 0.f;
+            summary.p90 = 0.f;
+            summary.p99 = 0.f;
+            summary.max = 0.f;
+            continue;
+        }
+
+        const uint64_t total = h.count.load(std::memory_order_relaxed);
+        const uint64_t sum_us = h.sum_us.load(std::memory_order_relaxed);
+
+        summary.mean = total > 0 ? (float)(sum_us / 1000.0 / total) : 0.f;
+        summary.p50 = percentile(buckets, count, 0.50);
+        summary.p90 = percentile(buckets, count, 0.90);
+        summary.p99 = percentile(buckets, count, 0.99);
+        summary.max = h.max_us.load(std::memory_order_relaxed) / 1000.f;
+    }
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        snapshot.counters[c] = g_counters[c].load(std::memory_order_relaxed);
+    }
+}
+
+void metrics_reset()
+{
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++)
+    {
+        StageHistogram& h = g_stages[s];
+        for (int i = 0; i < METRIC_BUCKETS; i++)
+        {
+            h.buckets[i].store(0, std::memory_order_relaxed);
+        }
+        h.count.store(0, std::memory_order_relaxed);
+        h.sum_us.store(0, std::memory_order_relaxed);
+        h.max_us.store(0, std::memory_order_relaxed);
+    }
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        g_counters[c].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* metrics_stage_name(int stage)
+{
+    return stage_names[stage];
+}
+
+const char* metrics_counter_name(int counter)
+{
+    return counter_names[counter];
+}
+
+void metrics_print(const MetricsSnapshot& snapshot, FILE* fp)
+{
+    fprintf(fp, "%-16s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++)
+    {
+        const MetricStageSummary& summary = snapshot.stages[s];
+        if (summary.count == 0)
+            continue;
+
+        fprintf(fp, "%-16s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", stage_names[s], (unsigned long long)summary.count, summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+    }
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        fprintf(fp, "%-16s %10lld\n", counter_names[c], (long long)snapshot.counters[c]);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <benchmark.h>
+
+// process-wide latency histograms and counters, safe to update from any thread without locks
+
+enum MetricStage
+{
+    METRIC_NV21_REPACK = 0,
+    METRIC_CROP_ROTATE,
+    METRIC_RGB_CONVERT,
+    METRIC_DETECT_EXTRACT,
+    METRIC_DECODE,
+    METRIC_NMS,
+    METRIC_LANDMARK, // one sample per face
+    METRIC_DRAW,
+    METRIC_WINDOW_POST,
+    METRIC_STAGE_COUNT
+};
+
+enum MetricCounter
+{
+    METRIC_FRAMES = 0,
+    METRIC_DROPS,
+    METRIC_FACES,
+    METRIC_SKIPS, // frames that reused the previous results, see motiongate.h
+    METRIC_COUNTER_COUNT
+};
+
+struct MetricStageSummary
+{
+    uint64_t count;
+    // ms, percentiles are accurate to the histogram bucket, about 12%
+    float mean;
+    float p50;
+    float p90;
+    float p99;
+    float max;
+};
+
+struct MetricsSnapshot
+{
+    MetricStageSummary stages[METRIC_STAGE_COUNT];
+    int64_t counters[METRIC_COUNTER_COUNT];
+};
+
+void metrics_record(int stage, double ms);
+void metrics_add(int counter, int64_t value = 1);
+
+void metrics_snapshot(MetricsSnapshot& snapshot);
+void metrics_reset();
+
+const char* metrics_stage_name(int stage);
+const char* metrics_counter_name(int counter);
+
+// one line per stage and counter
+void metrics_print(const MetricsSnapshot& snapshot, FILE* fp);
+
+// records the scope duration into stage
+class MetricTimer
+{
+public:
+    explicit MetricTimer(int _stage) : stage(_stage), start(ncnn::get_current_time()) {}
+    ~MetricTimer() { metrics_record(stage, ncnn::get_current_time() - start); }
+
+private:
+    int stage;
+    double start;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,196 @@
+#include "motiongate.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+#if __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+// 4x4 box average of four rows starting at r0 into w4 pixels
+static void downsample_row4(const unsigned char* r0, int stride, unsigned char* dst, int w4)
+{
+    const unsigned char* r1 = r0 + stride;
+    const unsigned char* r2 = r1 + stride;
+    const unsigned char* r3 = r2 + stride;
+
+    int x = 0;
+#if __ARM_NEON
+    for (; x + 7 < w4; x += 8)
+    {
+        // 32 pixels of 4 rows, horizontal pairs then vertical then pairs again
+        uint16x8_t _s0 = vpaddlq_u8(vld1q_u8(r0));
+        uint16x8_t _s1 = vpaddlq_u8(vld1q_u8(r0 + 16));
+        _s0 = vpadalq_u8(_s0, vld1q_u8(r1));
+        _s1 = vpadalq_u8(_s1, vld1q_u8(r1 + 16));
+        _s0 = vpadalq_u8(_s0, vld1q_u8(r2));
+        _s1 = vpadalq_u8(_s1, vld1q_u8(r2 + 16));
+        _s0 = vpadalq_u8(_s0, vld1q_u8(r3));
+        _s1 = vpadalq_u8(_s1, vld1q_u8(r3 + 16));
+
+        uint16x8_t _s = vcombine_u16(vpadd_u16(vget_low_u16(_s0), vget_high_u16(_s0)), vpadd_u16(vget_low_u16(_s1), vget_high_u16(_s1)));
+        vst1_u8(dst, vrshrn_n_u16(_s, 4));
+
+        r0 += 32;
+        r1 += 32;
+        r2 += 32;
+        r3 += 32;
+        dst += 8;
+    }
+#endif // __ARM_NEON
+    for (; x < w4; x++)
+    {
+        int sum = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            sum += r0[k] + r1[k] + r2[k] + r3[k];
+        }
+        dst[0] = (sum + 8) >> 4;
+
+        r0 += 4;
+        r1 += 4;
+        r2 += 4;
+        r3 += 4;
+        dst += 1;
+    }
+}
+
+static unsigned int sad_row(const unsigned char* a, const unsigned char* b, int n)
+{
+    unsigned int sum = 0;
+
+    int x = 0;
+#if __ARM_NEON
+    uint32x4_t _sum = vdupq_n_u32(0);
+    for (; x + 15 < n; x += 16)
+    {
+        uint8x16_t _d = vabdq_u8(vld1q_u8(a), vld1q_u8(b));
+        _sum = vpadalq_u16(_sum, vpaddlq_u8(_d));
+        a += 16;
+        b += 16;
+    }
+    uint64x2_t _sum64 = vpaddlq_u32(_sum);
+    sum = (unsigned int)(vgetq_lane_u64(_sum64, 0) + vgetq_lane_u64(_sum64, 1));
+#elif __SSE2__
+    __m128i _sum = _mm_setzero_si128();
+    for (; x + 15 < n; x += 16)
+    {
+        _sum = _mm_add_epi64(_sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b)));
+        a += 16;
+        b += 16;
+    }
+    sum = _mm_cvtsi128_si32(_sum) + _mm_cvtsi128_si32(_mm_srli_si128(_sum, 8));
+#endif
+    for (; x < n; x++)
+    {
+        sum += abs(a[0] - b[0]);
+        a++;
+        b++;
+    }
+
+    return sum;
+}
+
+// mean absolute difference over a grid rect
+static float mean_abs_diff(const unsigned char* a, const unsigned char* b, int grid_w, const cv::Rect& r)
+{
+    if (r.width <= 0 || r.height <= 0)
+        return 0.f;
+
+    uint64_t sum = 0;
+    for (int y = r.y; y < r.y + r.height; y++)
+    {
+        sum += sad_row(a + y * grid_w + r.x, b + y * grid_w + r.x, r.width);
+    }
+
+    return (float)sum / (r.width * r.height);
+}
+
+MotionGate::MotionGate()
+{
+    threshold = 0.f;
+    region_threshold = 0.f;
+    max_skip = 30;
+
+    frame_diff = 0.f;
+    region_diff = 0.f;
+
+    grid_w = 0;
+    grid_h = 0;
+    reference_w = 0;
+    reference_h = 0;
+    skipped = 0;
+}
+
+bool MotionGate::check(const unsigned char* y, int width, int height, int stride, const std::vector<cv::Rect>& regions)
+{
+    if (threshold <= 0.f)
+        return false;
+
+    grid_w = width / 4;
+    grid_h = height / 4;
+
+    current.resize(grid_w * grid_h);
+    for (int i = 0; i < grid_h; i++)
+    {
+        downsample_row4(y + i * 4 * stride, stride, current.data() + i * grid_w, grid_w);
+    }
+
+    frame_diff = 0.f;
+    region_diff = 0.f;
+
+    if (reference_w != grid_w || reference_h != grid_h || grid_w == 0 || grid_h == 0)
+        return false;
+
+    if (max_skip > 0 && skipped >= max_skip)
+        return false;
+
+    const cv::Rect grid(0, 0, grid_w, grid_h);
+
+    frame_diff = mean_abs_diff(current.data(), reference.data(), grid_w, grid);
+    if (frame_diff > threshold)
+        return false;
+
+    if (region_threshold > 0.f)
+    {
+        for (size_t i = 0; i < regions.size(); i++)
+        {
+            const cv::Rect& r = regions[i];
+
+            // grown by half the face size, in grid pixels
+            const int x0 = (r.x - r.width / 4) / 4;
+            const int y0 = (r.y - r.height / 4) / 4;
+            const int x1 = (r.x + r.width + r.width / 4 + 3) / 4;
+            const int y1 = (r.y + r.height + r.height / 4 + 3) / 4;
+
+            const float diff = mean_abs_diff(current.data(), reference.data(), grid_w, cv::Rect(x0, y0, x1 - x0, y1 - y0) & grid);
+            region_diff = std::max(region_diff, diff);
+        }
+
+        if (region_diff > region_threshold)
+            return false;
+    }
+
+    skipped++;
+    return true;
+}
+
+void MotionGate::accept()
+{
+    std::swap(current, reference);
+    reference_w = grid_w;
+    reference_h = grid_h;
+    skipped = 0;
+}
+
+void MotionGate::reset()
+{
+    reference_w = 0;
+    reference_h = 0;
+    skipped = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef MOTIONGATE_H
+#define MOTIONGATE_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// frame change detector on the luma plane, for skipping inference on unchanged frames
+// frames are box averaged 4x4 and compared by mean absolute difference
+// against the last frame inference ran on, so slow drift still adds up to a run
+class MotionGate
+{
+public:
+    MotionGate();
+
+    // downsample y and compare, true when this frame may reuse the previous results
+    // regions are known faces in y pixels, each grown by half its size and checked on its own
+    bool check(const unsigned char* y, int width, int height, int stride, const std::vector<cv::Rect>& regions);
+
+    // inference ran on the last checked frame, make it the reference
+    void accept();
+
+    // forget the reference, the next frame always runs
+    void reset();
+
+public:
+    // mean absolute luma difference over the frame, 0 = gate off
+    float threshold;
+
+    // same over each face region, 0 = frame threshold only
+    float region_threshold;
+
+    // longest run of skipped frames before one is forced through, 0 = no limit
+    int max_skip;
+
+    // differences measured by the last check, for tuning
+    float frame_diff;
+    float region_diff;
+
+private:
+    std::vector<unsigned char> current;
+    std::vector<unsigned char> reference;
+    int grid_w;
+    int grid_h;
+    int reference_w;
+    int reference_h;
+    int skipped;
+};
+
+#endif // MOTIONGATE_H
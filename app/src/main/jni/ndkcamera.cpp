@@ -22,6 +22,11 @@
 
 #include "mat.h"
 
+#include "cpuaffinity.h"
+#include "metrics.h"
+#include "pixelconvert.h"
+#include "trace.h"
+
 static void onDisconnected(void* context, ACameraDevice* device)
 {
     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onDisconnected %p", device);
@@ -34,14 +39,19 @@ static void onError(void* context, ACameraDevice* device, int error)
 
 static void onImageAvailable(void* context, AImageReader* reader)
 {
+    SCRFD_TRACE_SCOPE("onImageAvailable");
+
 //     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onImageAvailable %p", reader);
 
+    set_current_thread_affinity(((NdkCamera*)context)->camera_powersave);
+
     AImage* image = 0;
     media_status_t status = AImageReader_acquireLatestImage(reader, &image);
 
     if (status != AMEDIA_OK)
     {
         // error
+        metrics_add(METRIC_DROPS);
         return;
     }
 
@@ -89,34 +99,9 @@ static void onImageAvailable(void* context, AImageReader* reader)
         // construct nv21
         unsigned char* nv21 = new unsigned char[width * height + width * height / 2];
         {
-            // Y
-            unsigned char* yptr = nv21;
-            for (int y=0; y<height; y++)
-            {
-                const unsigned char* y_data_ptr = y_data + y_rowStride * y;
-                for (int x=0; x<width; x++)
-                {
-                    yptr[0] = y_data_ptr[0];
-                    yptr++;
-                    y_data_ptr += y_pixelStride;
-                }
-            }
+            MetricTimer timer(METRIC_NV21_REPACK);
 
-            // UV
-            unsigned char* uvptr = nv21 + width * height;
-            for (int y=0; y<height/2; y++)
-            {
-                const unsigned char* v_data_ptr = v_data + v_rowStride * y;
-                const unsigned char* u_data_ptr = u_data + u_rowStride * y;
-                for (int x=0; x<width/2; x++)
-                {
-                    uvptr[0] = v_data_ptr[0];
-                    uvptr[1] = u_data_ptr[0];
-                    uvptr += 2;
-                    v_data_ptr += v_pixelStride;
-                    u_data_ptr += u_pixelStride;
-                }
-            }
+            yuv420888_to_nv21(y_data, u_data, v_data, width, height, y_rowStride, u_rowStride, v_rowStride, y_pixelStride, u_pixelStride, v_pixelStride, nv21);
         }
 
         ((NdkCamera*)context)->on_image((unsigned char*)nv21, (int)width, (int)height);
@@ -162,10 +147,9 @@ void onCaptureCompleted(void* context, ACameraCaptureSession* session, ACaptureR
 //     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onCaptureCompleted %p %p %p", session, request, result);
 }
 
-NdkCamera::NdkCamera()
+NdkCamera::NdkCamera() : FrameSource()
 {
-    camera_facing = 0;
-    camera_orientation = 0;
+    camera_powersave = 1;
 
     camera_manager = 0;
     camera_device = 0;
@@ -372,53 +356,6 @@ void NdkCamera::close()
     }
 }
 
-void NdkCamera::on_image(const cv::Mat& rgb) const
-{
-}
-
-void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
-{
-    // rotate nv21
-    int w = 0;
-    int h = 0;
-    int rotate_type = 0;
-    {
-        if (camera_orientation == 0)
-        {
-            w = nv21_width;
-            h = nv21_height;
-            rotate_type = camera_facing == 0 ? 2 : 1;
-        }
-        if (camera_orientation == 90)
-        {
-            w = nv21_height;
-            h = nv21_width;
-            rotate_type = camera_facing == 0 ? 5 : 6;
-        }
-        if (camera_orientation == 180)
-        {
-            w = nv21_width;
-            h = nv21_height;
-            rotate_type = camera_facing == 0 ? 4 : 3;
-        }
-        if (camera_orientation == 270)
-        {
-            w = nv21_height;
-            h = nv21_width;
-            rotate_type = camera_facing == 0 ? 7 : 8;
-        }
-    }
-
-    cv::Mat nv21_rotated(h + h / 2, w, CV_8UC1);
-    ncnn::kanna_rotate_yuv420sp(nv21, nv21_width, nv21_height, nv21_rotated.data, w, h, rotate_type);
-
-    // nv21_rotated to rgb
-    cv::Mat rgb(h, w, CV_8UC3);
-    ncnn::yuv420sp2rgb(nv21_rotated.data, w, h, rgb.data);
-
-    on_image(rgb);
-}
-
 static const int NDKCAMERAWINDOW_ID = 233;
 
 NdkCameraWindow::NdkCameraWindow() : NdkCamera()
@@ -467,12 +404,10 @@ void NdkCameraWindow::set_window(ANativeWindow* _win)
     ANativeWindow_acquire(win);
 }
 
-void NdkCameraWindow::on_image_render(cv::Mat& rgb) const
-{
-}
-
 void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
 {
+    SCRFD_TRACE_SCOPE("on_image");
+
     // resolve orientation from camera_orientation and accelerometer_sensor
     {
         if (!sensor_event_queue)
@@ -521,251 +456,32 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
         }
     }
 
-    // roi crop and rotate nv21
-    int nv21_roi_x = 0;
-    int nv21_roi_y = 0;
-    int nv21_roi_w = 0;
-    int nv21_roi_h = 0;
-    int roi_x = 0;
-    int roi_y = 0;
-    int roi_w = 0;
-    int roi_h = 0;
-    int rotate_type = 0;
-    int render_w = 0;
-    int render_h = 0;
-    int render_rotate_type = 0;
+    FrameGeometry g;
     {
         int win_w = ANativeWindow_getWidth(win);
         int win_h = ANativeWindow_getHeight(win);
 
-        if (accelerometer_orientation == 90 || accelerometer_orientation == 270)
-        {
-            std::swap(win_w, win_h);
-        }
-
-        const int final_orientation = (camera_orientation + accelerometer_orientation) % 360;
-
-        if (final_orientation == 0 || final_orientation == 180)
-        {
-            if (win_w * nv21_height > win_h * nv21_width)
-            {
-                roi_w = nv21_width;
-                roi_h = (nv21_width * win_h / win_w) / 2 * 2;
-                roi_x = 0;
-                roi_y = ((nv21_height - roi_h) / 2) / 2 * 2;
-            }
-            else
-            {
-                roi_h = nv21_height;
-                roi_w = (nv21_height * win_w / win_h) / 2 * 2;
-                roi_x = ((nv21_width - roi_w) / 2) / 2 * 2;
-                roi_y = 0;
-            }
-
-            nv21_roi_x = roi_x;
-            nv21_roi_y = roi_y;
-            nv21_roi_w = roi_w;
-            nv21_roi_h = roi_h;
-        }
-        if (final_orientation == 90 || final_orientation == 270)
-        {
-            if (win_w * nv21_width > win_h * nv21_height)
-            {
-                roi_w = nv21_height;
-                roi_h = (nv21_height * win_h / win_w) / 2 * 2;
-                roi_x = 0;
-                roi_y = ((nv21_width - roi_h) / 2) / 2 * 2;
-            }
-            else
-            {
-                roi_h = nv21_width;
-                roi_w = (nv21_width * win_w / win_h) / 2 * 2;
-                roi_x = ((nv21_height - roi_w) / 2) / 2 * 2;
-                roi_y = 0;
-            }
-
-            nv21_roi_x = roi_y;
-            nv21_roi_y = roi_x;
-            nv21_roi_w = roi_h;
-            nv21_roi_h = roi_w;
-        }
-
-        if (camera_facing == 0)
-        {
-            if (camera_orientation == 0 && accelerometer_orientation == 0)
-            {
-                rotate_type = 2;
-            }
-            if (camera_orientation == 0 && accelerometer_orientation == 90)
-            {
-                rotate_type = 7;
-            }
-            if (camera_orientation == 0 && accelerometer_orientation == 180)
-            {
-                rotate_type = 4;
-            }
-            if (camera_orientation == 0 && accelerometer_orientation == 270)
-            {
-                rotate_type = 5;
-            }
-            if (camera_orientation == 90 && accelerometer_orientation == 0)
-            {
-                rotate_type = 5;
-            }
-            if (camera_orientation == 90 && accelerometer_orientation == 90)
-            {
-                rotate_type = 2;
-            }
-            if (camera_orientation == 90 && accelerometer_orientation == 180)
-            {
-                rotate_type = 7;
-            }
-            if (camera_orientation == 90 && accelerometer_orientation == 270)
-            {
-                rotate_type = 4;
-            }
-            if (camera_orientation == 180 && accelerometer_orientation == 0)
-            {
-                rotate_type = 4;
-            }
-            if (camera_orientation == 180 && accelerometer_orientation == 90)
-            {
-                rotate_type = 5;
-            }
-            if (camera_orientation == 180 && accelerometer_orientation == 180)
-            {
-                rotate_type = 2;
-            }
-            if (camera_orientation == 180 && accelerometer_orientation == 270)
-            {
-                rotate_type = 7;
-            }
-            if (camera_orientation == 270 && accelerometer_orientation == 0)
-            {
-                rotate_type = 7;
-            }
-            if (camera_orientation == 270 && accelerometer_orientation == 90)
-            {
-                rotate_type = 4;
-            }
-            if (camera_orientation == 270 && accelerometer_orientation == 180)
-            {
-                rotate_type = 5;
-            }
-            if (camera_orientation == 270 && accelerometer_orientation == 270)
-            {
-                rotate_type = 2;
-            }
-        }
-        else
-        {
-            if (final_orientation == 0)
-            {
-                rotate_type = 1;
-            }
-            if (final_orientation == 90)
-            {
-                rotate_type = 6;
-            }
-            if (final_orientation == 180)
-            {
-                rotate_type = 3;
-            }
-            if (final_orientation == 270)
-            {
-                rotate_type = 8;
-            }
-        }
-
-        if (accelerometer_orientation == 0)
-        {
-            render_w = roi_w;
-            render_h = roi_h;
-            render_rotate_type = 1;
-        }
-        if (accelerometer_orientation == 90)
-        {
-            render_w = roi_h;
-            render_h = roi_w;
-            render_rotate_type = 8;
-        }
-        if (accelerometer_orientation == 180)
-        {
-            render_w = roi_w;
-            render_h = roi_h;
-            render_rotate_type = 3;
-        }
-        if (accelerometer_orientation == 270)
-        {
-            render_w = roi_h;
-            render_h = roi_w;
-            render_rotate_type = 6;
-        }
-    }
-
-    // crop and rotate nv21
-    cv::Mat nv21_croprotated(roi_h + roi_h / 2, roi_w, CV_8UC1);
-    {
-        const unsigned char* srcY = nv21 + nv21_roi_y * nv21_width + nv21_roi_x;
-        unsigned char* dstY = nv21_croprotated.data;
-        ncnn::kanna_rotate_c1(srcY, nv21_roi_w, nv21_roi_h, nv21_width, dstY, roi_w, roi_h, roi_w, rotate_type);
-
-        const unsigned char* srcUV = nv21 + nv21_width * nv21_height + nv21_roi_y * nv21_width / 2 + nv21_roi_x;
-        unsigned char* dstUV = nv21_croprotated.data + roi_w * roi_h;
-        ncnn::kanna_rotate_c2(srcUV, nv21_roi_w / 2, nv21_roi_h / 2, nv21_width, dstUV, roi_w / 2, roi_h / 2, roi_w, rotate_type);
+        frame_geometry(nv21_width, nv21_height, camera_facing, camera_orientation, accelerometer_orientation, win_w, win_h, g);
     }
 
-    // nv21_croprotated to rgb
-    cv::Mat rgb(roi_h, roi_w, CV_8UC3);
-    ncnn::yuv420sp2rgb(nv21_croprotated.data, roi_w, roi_h, rgb.data);
-
-    on_image_render(rgb);
-
-    // rotate to native window orientation
-    cv::Mat rgb_render(render_h, render_w, CV_8UC3);
-    ncnn::kanna_rotate_c3(rgb.data, roi_w, roi_h, rgb_render.data, render_w, render_h, render_rotate_type);
+    on_image_window(nv21, nv21_width, nv21_height, g);
+}
 
-    ANativeWindow_setBuffersGeometry(win, render_w, render_h, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
+unsigned char* NdkCameraWindow::lock_window(int width, int height, int* stride) const
+{
+    ANativeWindow_setBuffersGeometry(win, width, height, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
 
     ANativeWindow_Buffer buf;
     ANativeWindow_lock(win, &buf, NULL);
 
-    // scale to target size
-    if (buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM || buf.format == AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM)
-    {
-        for (int y = 0; y < render_h; y++)
-        {
-            const unsigned char* ptr = rgb_render.ptr<const unsigned char>(y);
-            unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
+    if (buf.format != AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM && buf.format != AHARDWAREBUFFER_FORMAT_R8G8B8X8_UNORM)
+        return 0;
 
-            int x = 0;
-#if __ARM_NEON
-            for (; x + 7 < render_w; x += 8)
-            {
-                uint8x8x3_t _rgb = vld3_u8(ptr);
-                uint8x8x4_t _rgba;
-                _rgba.val[0] = _rgb.val[0];
-                _rgba.val[1] = _rgb.val[1];
-                _rgba.val[2] = _rgb.val[2];
-                _rgba.val[3] = vdup_n_u8(255);
-                vst4_u8(outptr, _rgba);
-
-                ptr += 24;
-                outptr += 32;
-            }
-#endif // __ARM_NEON
-            for (; x < render_w; x++)
-            {
-                outptr[0] = ptr[0];
-                outptr[1] = ptr[1];
-                outptr[2] = ptr[2];
-                outptr[3] = 255;
-
-                ptr += 3;
-                outptr += 4;
-            }
-        }
-    }
+    *stride = buf.stride * 4;
+    return (unsigned char*)buf.bits;
+}
 
+void NdkCameraWindow::unlock_window() const
+{
     ANativeWindow_unlockAndPost(win);
 }
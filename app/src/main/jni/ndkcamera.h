@@ -25,23 +25,21 @@
 
 #include <opencv2/core/core.hpp>
 
-class NdkCamera
+#include "framesource.h"
+
+class NdkCamera : public FrameSource
 {
 public:
     NdkCamera();
     virtual ~NdkCamera();
 
     // facing 0=front 1=back
-    int open(int camera_facing = 0);
-    void close();
-
-    virtual void on_image(const cv::Mat& rgb) const;
-
-    virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
+    virtual int open(int camera_facing = 0);
+    virtual void close();
 
 public:
-    int camera_facing;
-    int camera_orientation;
+    // cores for the camera callback thread, 0 = all 1 = little 2 = big, see cpuaffinity.h
+    int camera_powersave;
 
 private:
     ACameraManager* camera_manager;
@@ -63,10 +61,11 @@ public:
 
     void set_window(ANativeWindow* win);
 
-    virtual void on_image_render(cv::Mat& rgb) const;
-
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
+    virtual unsigned char* lock_window(int width, int height, int* stride) const;
+    virtual void unlock_window() const;
+
 public:
     mutable int accelerometer_orientation;
 
@@ -0,0 +1,308 @@
+#include "overlay.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "rotation.h"
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+#if __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+OverlayImage overlay_image(cv::Mat& m)
+{
+    OverlayImage im;
+    im.data = m.data;
+    im.w = m.cols;
+    im.h = m.rows;
+    im.stride = (int)m.step;
+    im.channels = m.channels();
+    return im;
+}
+
+static void fill_row_rgb(unsigned char* ptr, int n, const unsigned char color[4])
+{
+    int x = 0;
+#if __ARM_NEON
+    uint8x16x3_t _rgb;
+    _rgb.val[0] = vdupq_n_u8(color[0]);
+    _rgb.val[1] = vdupq_n_u8(color[1]);
+    _rgb.val[2] = vdupq_n_u8(color[2]);
+    for (; x + 15 < n; x += 16)
+    {
+        vst3q_u8(ptr, _rgb);
+        ptr += 48;
+    }
+#elif __SSE2__
+    if (n >= 16)
+    {
+        // 16 pixels = 3 registers of the repeating rgb pattern
+        unsigned char pattern[48];
+        for (int i = 0; i < 16; i++)
+        {
+            pattern[i * 3] = color[0];
+            pattern[i * 3 + 1] = color[1];
+            pattern[i * 3 + 2] = color[2];
+        }
+        __m128i _p0 = _mm_loadu_si128((const __m128i*)pattern);
+        __m128i _p1 = _mm_loadu_si128((const __m128i*)(pattern + 16));
+        __m128i _p2 = _mm_loadu_si128((const __m128i*)(pattern + 32));
+        for (; x + 15 < n; x += 16)
+        {
+            _mm_storeu_si128((__m128i*)ptr, _p0);
+            _mm_storeu_si128((__m128i*)(ptr + 16), _p1);
+            _mm_storeu_si128((__m128i*)(ptr + 32), _p2);
+            ptr += 48;
+        }
+    }
+#endif
+    for (; x < n; x++)
+    {
+        ptr[0] = color[0];
+        ptr[1] = color[1];
+        ptr[2] = color[2];
+        ptr += 3;
+    }
+}
+
+static void fill_row_rgba(unsigned char* ptr, int n, const unsigned char color[4])
+{
+    unsigned int value;
+    memcpy(&value, color, 4);
+
+    int x = 0;
+#if __ARM_NEON
+    uint32x4_t _v = vdupq_n_u32(value);
+    for (; x + 3 < n; x += 4)
+    {
+        vst1q_u32((unsigned int*)ptr, _v);
+        ptr += 16;
+    }
+#elif __SSE2__
+    __m128i _v = _mm_set1_epi32((int)value);
+    for (; x + 3 < n; x += 4)
+    {
+        _mm_storeu_si128((__m128i*)ptr, _v);
+        ptr += 16;
+    }
+#endif
+    for (; x < n; x++)
+    {
+        memcpy(ptr, &value, 4);
+        ptr += 4;
+    }
+}
+
+// clipped horizontal span [x0, x1) on row y
+static inline void fill_span(const OverlayImage& im, int y, int x0, int x1, const unsigned char color[4])
+{
+    if (y < 0 || y >= im.h)
+        return;
+
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > im.w)
+        x1 = im.w;
+    if (x0 >= x1)
+        return;
+
+    unsigned char* ptr = im.data + y * im.stride + x0 * im.channels;
+    if (im.channels == 4)
+        fill_row_rgba(ptr, x1 - x0, color);
+    else
+        fill_row_rgb(ptr, x1 - x0, color);
+}
+
+void overlay_fill_rect(const OverlayImage& im, int x, int y, int w, int h, const unsigned char color[4])
+{
+    const int y0 = std::max(y, 0);
+    const int y1 = std::min(y + h, im.h);
+    for (int yy = y0; yy < y1; yy++)
+    {
+        fill_span(im, yy, x, x + w, color);
+    }
+}
+
+void overlay_rect(const OverlayImage& im, int x, int y, int w, int h, const unsigned char color[4])
+{
+    if (w <= 0 || h <= 0)
+        return;
+
+    fill_span(im, y, x, x + w, color);
+    fill_span(im, y + h - 1, x, x + w, color);
+
+    const int y0 = std::max(y + 1, 0);
+    const int y1 = std::min(y + h - 1, im.h);
+    for (int yy = y0; yy < y1; yy++)
+    {
+        fill_span(im, yy, x, x + 1, color);
+        fill_span(im, yy, x + w - 1, x + w, color);
+    }
+}
+
+void overlay_points(const OverlayImage& im, const cv::Point2f* points, int count, const unsigned char color[4])
+{
+    // radius 2 disc as row half widths
+    static const int half_widths[5] = {1, 2, 2, 2, 1};
+
+    for (int i = 0; i < count; i++)
+    {
+        const int cx = cvRound(points[i].x);
+        const int cy = cvRound(points[i].y);
+
+        for (int k = 0; k < 5; k++)
+        {
+            const int hw = half_widths[k];
+            fill_span(im, cy + k - 2, cx - hw, cx + hw + 1, color);
+        }
+    }
+}
+
+// 5x7 bitmap font, one byte per row, bit 4 is the leftmost dot
+struct Glyph
+{
+    char c;
+    unsigned char rows[7];
+};
+
+static const Glyph glyphs[] =
+{
+    {'0', {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}},
+    {'1', {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {'2', {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}},
+    {'3', {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}},
+    {'4', {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}},
+    {'5', {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}},
+    {'6', {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}},
+    {'7', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}},
+    {'9', {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}
+};
+
+// glyph rows pre-rasterized into horizontal runs, so drawing is row fills only
+struct GlyphRun
+{
+    unsigned char x;
+    unsigned char len;
+};
+
+struct GlyphAtlas
+{
+    GlyphAtlas();
+
+    // at most 3 runs in a 5 dot row
+    GlyphRun runs[128][7][3];
+    unsigned char run_count[128][7];
+};
+
+GlyphAtlas::GlyphAtlas()
+{
+    memset(run_count, 0, sizeof(run_count));
+
+    for (size_t i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); i++)
+    {
+        const Glyph& g = glyphs[i];
+        for (int r = 0; r < 7; r++)
+        {
+            int x = 0;
+            while (x < 5)
+            {
+                if (!(g.rows[r] & (0x10 >> x)))
+                {
+                    x++;
+                    continue;
+                }
+
+                int len = 1;
+                while (x + len < 5 && (g.rows[r] & (0x10 >> (x + len))))
+                    len++;
+
+                GlyphRun& run = runs[(int)g.c][r][run_count[(int)g.c][r]++];
+                run.x = x;
+                run.len = len;
+
+                x += len;
+            }
+        }
+    }
+}
+
+static const GlyphAtlas& glyph_atlas()
+{
+    static GlyphAtlas atlas;
+    return atlas;
+}
+
+void overlay_text_size(const char* text, int scale, int* w, int* h)
+{
+    // 5 dots and 1 dot spacing per glyph
+    *w = (int)strlen(text) * 6 * scale;
+    *h = 7 * scale;
+}
+
+void overlay_text(const OverlayImage& im, int x, int y, const char* text, int scale, const unsigned char color[4])
+{
+    const GlyphAtlas& atlas = glyph_atlas();
+
+    for (const char* p = text; *p; p++)
+    {
+        const int c = *p & 127;
+
+        for (int r = 0; r < 7; r++)
+        {
+            for (int k = 0; k < atlas.run_count[c][r]; k++)
+            {
+                const GlyphRun& run = atlas.runs[c][r][k];
+                const int x0 = x + run.x * scale;
+                const int x1 = x0 + run.len * scale;
+                for (int s = 0; s < scale; s++)
+                {
+                    fill_span(im, y + r * scale + s, x0, x1, color);
+                }
+            }
+        }
+
+        x += 6 * scale;
+    }
+}
+
+void overlay_text(const OverlayImage& im, int x, int y, const char* text, int scale, const unsigned char color[4], int rotate_type)
+{
+    if (rotate_type == 1)
+    {
+        overlay_text(im, x, y, text, scale, color);
+        return;
+    }
+
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type_inverse(rotate_type), im.w, im.h, &upright_w, &upright_h);
+
+    const GlyphAtlas& atlas = glyph_atlas();
+
+    // each run becomes a rect, rows of the upright glyph may turn into columns of im
+    for (const char* p = text; *p; p++)
+    {
+        const int c = *p & 127;
+
+        for (int r = 0; r < 7; r++)
+        {
+            for (int k = 0; k < atlas.run_count[c][r]; k++)
+            {
+                const GlyphRun& run = atlas.runs[c][r][k];
+                const cv::Rect_<float> box(x + run.x * scale, y + r * scale, run.len * scale, scale);
+                const cv::Rect_<float> rbox = rotate_rect(rotate_type, upright_w, upright_h, box);
+                overlay_fill_rect(im, (int)rbox.x, (int)rbox.y, (int)rbox.width, (int)rbox.height, color);
+            }
+        }
+
+        x += 6 * scale;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include <opencv2/core/core.hpp>
+
+// fast overlay drawing straight into 8-bit rgb or rgba pixels
+// every primitive is built from clipped horizontal row fills, no anti-aliasing
+
+struct OverlayImage
+{
+    unsigned char* data;
+    int w;
+    int h;
+    int stride; // bytes per row
+    int channels; // 3 = rgb 4 = rgba, alpha is written as color[3]
+};
+
+// wraps a CV_8UC3 or CV_8UC4 mat
+OverlayImage overlay_image(cv::Mat& m);
+
+void overlay_fill_rect(const OverlayImage& im, int x, int y, int w, int h, const unsigned char color[4]);
+
+// 1 pixel outline
+void overlay_rect(const OverlayImage& im, int x, int y, int w, int h, const unsigned char color[4]);
+
+// filled radius 2 dots, same footprint as cv::circle(img, pt, 2, color, -1)
+void overlay_points(const OverlayImage& im, const cv::Point2f* points, int count, const unsigned char color[4]);
+
+// 5x7 glyph atlas with digits . % and space, scale = pixels per glyph dot
+void overlay_text_size(const char* text, int scale, int* w, int* h);
+void overlay_text(const OverlayImage& im, int x, int y, const char* text, int scale, const unsigned char color[4]);
+
+// im is an upright frame turned by rotate_type, see rotation.h
+// x y and the text layout are in the upright frame, so the text reads upright to the viewer
+void overlay_text(const OverlayImage& im, int x, int y, const char* text, int scale, const unsigned char color[4], int rotate_type);
+
+#endif // OVERLAY_H
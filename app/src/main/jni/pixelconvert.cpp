@@ -0,0 +1,49 @@
+#include "pixelconvert.h"
+
+#include "simdkernels.h"
+
+void yuv420888_to_nv21(const unsigned char* y_data, const unsigned char* u_data, const unsigned char* v_data,
+                       int width, int height,
+                       int y_rowStride, int u_rowStride, int v_rowStride,
+                       int y_pixelStride, int u_pixelStride, int v_pixelStride,
+                       unsigned char* nv21)
+{
+    // Y
+    unsigned char* yptr = nv21;
+    for (int y=0; y<height; y++)
+    {
+        const unsigned char* y_data_ptr = y_data + y_rowStride * y;
+        for (int x=0; x<width; x++)
+        {
+            yptr[0] = y_data_ptr[0];
+            yptr++;
+            y_data_ptr += y_pixelStride;
+        }
+    }
+
+    // UV
+    unsigned char* uvptr = nv21 + width * height;
+    for (int y=0; y<height/2; y++)
+    {
+        const unsigned char* v_data_ptr = v_data + v_rowStride * y;
+        const unsigned char* u_data_ptr = u_data + u_rowStride * y;
+        for (int x=0; x<width/2; x++)
+        {
+            uvptr[0] = v_data_ptr[0];
+            uvptr[1] = u_data_ptr[0];
+            uvptr += 2;
+            v_data_ptr += v_pixelStride;
+            u_data_ptr += u_pixelStride;
+        }
+    }
+}
+
+void rgb_to_rgba(const unsigned char* rgb, int width, int height, int rgb_stride, unsigned char* rgba, int rgba_stride)
+{
+    const SimdKernels& k = simd_kernels();
+
+    for (int y = 0; y < height; y++)
+    {
+        k.rgb_to_rgba(rgb + rgb_stride * y, rgba + rgba_stride * y, width);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef PIXELCONVERT_H
+#define PIXELCONVERT_H
+
+// camera frame conversions shared by ndkcamera and the host tools
+
+// repack AImage YUV_420_888 planes with any row and pixel stride into nv21, width x height * 3 / 2 bytes
+void yuv420888_to_nv21(const unsigned char* y_data, const unsigned char* u_data, const unsigned char* v_data,
+                       int width, int height,
+                       int y_rowStride, int u_rowStride, int v_rowStride,
+                       int y_pixelStride, int u_pixelStride, int v_pixelStride,
+                       unsigned char* nv21);
+
+// rgb to rgba with alpha 255, strides in bytes
+void rgb_to_rgba(const unsigned char* rgb, int width, int height, int rgb_stride, unsigned char* rgba, int rgba_stride);
+
+#endif // PIXELCONVERT_H
@@ -0,0 +1,213 @@
+#include "replaysource.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "trace.h"
+
+ReplaySource::ReplaySource() : FrameSource()
+{
+    fps = 0.f;
+    loops = 1;
+
+    y4m = false;
+    width = 0;
+    height = 0;
+    data_offset = 0;
+
+    stop = false;
+}
+
+ReplaySource::~ReplaySource()
+{
+    close();
+}
+
+int ReplaySource::load(const char* _path, int _width, int _height)
+{
+    path = _path;
+
+    const char* ext = strrchr(_path, '.');
+    y4m = ext && strcmp(ext, ".y4m") == 0;
+
+    if (!y4m)
+    {
+        if (_width <= 0 || _height <= 0 || _width % 2 != 0 || _height % 2 != 0)
+        {
+            fprintf(stderr, "raw nv21 %s needs even width and height\n", _path);
+            return -1;
+        }
+
+        width = _width;
+        height = _height;
+        data_offset = 0;
+        return 0;
+    }
+
+    FILE* fp = fopen(_path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", _path);
+        return -1;
+    }
+
+    // YUV4MPEG2 W640 H480 F30:1 Ip A1:1 C420jpeg
+    char header[256];
+    if (!fgets(header, sizeof(header), fp) || strncmp(header, "YUV4MPEG2 ", 10) != 0)
+    {
+        fprintf(stderr, "%s is not y4m\n", _path);
+        fclose(fp);
+        return -1;
+    }
+
+    width = 0;
+    height = 0;
+    bool is420 = true;
+    for (char* tok = strtok(header + 10, " \n"); tok; tok = strtok(0, " \n"))
+    {
+        if (tok[0] == 'W')
+            width = atoi(tok + 1);
+        if (tok[0] == 'H')
+            height = atoi(tok + 1);
+        if (tok[0] == 'C')
+            is420 = strncmp(tok + 1, "420", 3) == 0;
+    }
+
+    data_offset = ftell(fp);
+    fclose(fp);
+
+    if (!is420 || width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0)
+    {
+        fprintf(stderr, "%s must be 4:2:0 with even size\n", _path);
+        return -1;
+    }
+
+    return 0;
+}
+
+int ReplaySource::read_frame(FILE* fp, std::vector<unsigned char>& nv21, std::vector<unsigned char>& planar) const
+{
+    const size_t ysize = width * height;
+    const size_t uvsize = ysize / 4;
+
+    if (!y4m)
+        return fread(nv21.data(), 1, ysize + uvsize * 2, fp) == ysize + uvsize * 2 ? 0 : -1;
+
+    // FRAME [params]\n then planar Y U V
+    char line[256];
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, "FRAME", 5) != 0)
+        return -1;
+
+    if (fread(planar.data(), 1, ysize + uvsize * 2, fp) != ysize + uvsize * 2)
+        return -1;
+
+    memcpy(nv21.data(), planar.data(), ysize);
+
+    const unsigned char* u = planar.data() + ysize;
+    const unsigned char* v = u + uvsize;
+    unsigned char* vu = nv21.data() + ysize;
+    for (size_t i = 0; i < uvsize; i++)
+    {
+        vu[0] = v[i];
+        vu[1] = u[i];
+        vu += 2;
+    }
+
+    return 0;
+}
+
+int ReplaySource::run()
+{
+    if (width == 0)
+        return -1;
+
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path.c_str());
+        return -1;
+    }
+
+    std::vector<unsigned char> nv21(width * height * 3 / 2);
+    std::vector<unsigned char> planar(y4m ? width * height * 3 / 2 : 0);
+
+    const std::chrono::microseconds interval(fps > 0.f ? (long long)(1000000 / fps) : 0);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    int frames = 0;
+    for (int l = 0; l < loops && !stop; l++)
+    {
+        fseek(fp, data_offset, SEEK_SET);
+
+        while (!stop && read_frame(fp, nv21, planar) == 0)
+        {
+            if (fps > 0.f)
+            {
+                std::this_thread::sleep_until(next);
+                next += interval;
+            }
+
+            on_image(nv21.data(), width, height);
+            frames++;
+        }
+    }
+
+    fclose(fp);
+
+    return frames;
+}
+
+static void replay_thread(ReplaySource* source)
+{
+    source->run();
+}
+
+int ReplaySource::open(int _camera_facing)
+{
+    close();
+
+    camera_facing = _camera_facing;
+
+    stop = false;
+    thread = std::thread(replay_thread, this);
+
+    return 0;
+}
+
+void ReplaySource::close()
+{
+    stop = true;
+    wait();
+}
+
+void ReplaySource::wait()
+{
+    if (thread.joinable())
+        thread.join();
+}
+
+ReplayWindow::ReplayWindow() : ReplaySource()
+{
+    window_width = 720;
+    window_height = 1280;
+    accelerometer_orientation = 0;
+}
+
+void ReplayWindow::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
+{
+    SCRFD_TRACE_SCOPE("on_image");
+
+    FrameGeometry g;
+    frame_geometry(nv21_width, nv21_height, camera_facing, camera_orientation, accelerometer_orientation, window_width, window_height, g);
+
+    on_image_window(nv21, nv21_width, nv21_height, g);
+}
+
+unsigned char* ReplayWindow::lock_window(int width, int height, int* stride) const
+{
+    window.create(height, width, CV_8UC4);
+    *stride = (int)window.step;
+    return window.data;
+}
@@ -0,0 +1,79 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "framesource.h"
+
+// replays a raw nv21 or y4m 4:2:0 file as a camera, for running the pipeline off device
+// camera_facing and camera_orientation are fixed metadata of the recording, set them before open()
+class ReplaySource : public FrameSource
+{
+public:
+    ReplaySource();
+    virtual ~ReplaySource();
+
+    // .y4m takes the size from its header, anything else is raw nv21 frames of width x height
+    int load(const char* path, int width = 0, int height = 0);
+
+    // start playback on a new thread
+    virtual int open(int camera_facing = 0);
+    // stop and join the playback thread
+    virtual void close();
+
+    // block until playback started by open() has finished
+    void wait();
+
+    // play on the calling thread, returns the number of frames delivered or -1
+    int run();
+
+public:
+    // frames per second, 0 = as fast as possible
+    float fps;
+
+    // times to play the file
+    int loops;
+
+private:
+    int read_frame(FILE* fp, std::vector<unsigned char>& nv21, std::vector<unsigned char>& planar) const;
+
+    std::string path;
+    bool y4m;
+    int width;
+    int height;
+    long data_offset;
+
+    std::thread thread;
+    std::atomic<bool> stop;
+};
+
+// the NdkCameraWindow pipeline with a memory window instead of ANativeWindow
+// accelerometer_orientation is fixed instead of read from the sensor
+class ReplayWindow : public ReplaySource
+{
+public:
+    ReplayWindow();
+    // join playback before the window and the hooks of derived classes are gone
+    virtual ~ReplayWindow() { close(); }
+
+    virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
+
+    virtual unsigned char* lock_window(int width, int height, int* stride) const;
+
+public:
+    int window_width;
+    int window_height;
+    int accelerometer_orientation;
+
+    // last rendered frame, rgba
+    mutable cv::Mat window;
+};
+
+#endif // REPLAYSOURCE_H
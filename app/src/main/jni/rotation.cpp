@@ -0,0 +1,132 @@
+#include "rotation.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+void rotate_type_size(int rotate_type, int w, int h, int* outw, int* outh)
+{
+    if (rotate_type >= 5)
+        std::swap(w, h);
+
+    *outw = w;
+    *outh = h;
+}
+
+int rotate_type_inverse(int rotate_type)
+{
+    // all are their own inverse except the two 90 degree rotations
+    if (rotate_type == 6)
+        return 8;
+    if (rotate_type == 8)
+        return 6;
+
+    return rotate_type;
+}
+
+// x' = m0 x + m1 y + m2, y' = m3 x + m4 y + m5, a flip of x maps to xmax - x
+static void rotate_affine(int rotate_type, double xmax, double ymax, double m[6])
+{
+    m[0] = 0; m[1] = 0; m[2] = 0;
+    m[3] = 0; m[4] = 0; m[5] = 0;
+
+    switch (rotate_type)
+    {
+    case 2:
+        m[0] = -1; m[2] = xmax;
+        m[4] = 1;
+        break;
+    case 3:
+        m[0] = -1; m[2] = xmax;
+        m[4] = -1; m[5] = ymax;
+        break;
+    case 4:
+        m[0] = 1;
+        m[4] = -1; m[5] = ymax;
+        break;
+    case 5:
+        m[1] = 1;
+        m[3] = 1;
+        break;
+    case 6:
+        m[1] = -1; m[2] = ymax;
+        m[3] = 1;
+        break;
+    case 7:
+        m[1] = -1; m[2] = ymax;
+        m[3] = -1; m[5] = xmax;
+        break;
+    case 8:
+        m[1] = 1;
+        m[3] = -1; m[5] = xmax;
+        break;
+    default:
+        m[0] = 1;
+        m[4] = 1;
+        break;
+    }
+}
+
+int rotate_type_compose(int first, int second)
+{
+    // the translation follows from the sizes, so matching the linear part is enough
+    double m1[6];
+    double m2[6];
+    rotate_affine(first, 0, 0, m1);
+    rotate_affine(second, 0, 0, m2);
+
+    const double a = m2[0] * m1[0] + m2[1] * m1[3];
+    const double b = m2[0] * m1[1] + m2[1] * m1[4];
+    const double c = m2[3] * m1[0] + m2[4] * m1[3];
+    const double d = m2[3] * m1[1] + m2[4] * m1[4];
+
+    for (int rotate_type = 1; rotate_type <= 8; rotate_type++)
+    {
+        double m[6];
+        rotate_affine(rotate_type, 0, 0, m);
+        if (m[0] == a && m[1] == b && m[3] == c && m[4] == d)
+            return rotate_type;
+    }
+
+    return 1;
+}
+
+void rotate_type_affine(int rotate_type, int w, int h, double m[6])
+{
+    // pixel centers
+    rotate_affine(rotate_type, w - 1, h - 1, m);
+}
+
+void rotate_points(int rotate_type, int w, int h, cv::Point2f* points, int count)
+{
+    if (rotate_type == 1)
+        return;
+
+    double m[6];
+    rotate_affine(rotate_type, w - 1, h - 1, m);
+
+    for (int i = 0; i < count; i++)
+    {
+        const float x = points[i].x;
+        const float y = points[i].y;
+        points[i].x = m[0] * x + m[1] * y + m[2];
+        points[i].y = m[3] * x + m[4] * y + m[5];
+    }
+}
+
+cv::Rect_<float> rotate_rect(int rotate_type, int w, int h, const cv::Rect_<float>& rect)
+{
+    if (rotate_type == 1)
+        return rect;
+
+    // pixel edges
+    double m[6];
+    rotate_affine(rotate_type, w, h, m);
+
+    const float x0 = m[0] * rect.x + m[1] * rect.y + m[2];
+    const float y0 = m[3] * rect.x + m[4] * rect.y + m[5];
+    const float x1 = m[0] * (rect.x + rect.width) + m[1] * (rect.y + rect.height) + m[2];
+    const float y1 = m[3] * (rect.x + rect.width) + m[4] * (rect.y + rect.height) + m[5];
+
+    return cv::Rect_<float>(std::min(x0, x1), std::min(y0, y1), fabsf(x1 - x0), fabsf(y1 - y0));
+}
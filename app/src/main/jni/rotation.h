@@ -0,0 +1,28 @@
+#ifndef ROTATION_H
+#define ROTATION_H
+
+#include <opencv2/core/core.hpp>
+
+// ncnn::kanna_rotate_* rotate_type as coordinate transforms
+// 1 = copy 2 = flip x 3 = rotate 180 4 = flip y 5 = transpose 6 = rotate 90 cw 7 = transverse 8 = rotate 90 ccw
+// a w x h source becomes h x w for 5 to 8
+
+// size of w x h after rotation
+void rotate_type_size(int rotate_type, int w, int h, int* outw, int* outh);
+
+// the type that undoes rotate_type
+int rotate_type_inverse(int rotate_type);
+
+// the single type that does first and then second
+int rotate_type_compose(int first, int second);
+
+// 2x3 row major transform of pixel coordinates from the w x h source into the rotated image
+void rotate_type_affine(int rotate_type, int w, int h, double m[6]);
+
+// map pixel coordinates from the w x h source into the rotated image, in place
+void rotate_points(int rotate_type, int w, int h, cv::Point2f* points, int count);
+
+// map a box from the w x h source into the rotated image, the box edges move with the pixels they cover
+cv::Rect_<float> rotate_rect(int rotate_type, int w, int h, const cv::Rect_<float>& rect);
+
+#endif // ROTATION_H
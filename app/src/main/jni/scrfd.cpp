@@ -13,14 +13,26 @@
 // specific language governing permissions and limitations under the License.
 
 #include "scrfd.h"
+#include "scrfdkernels.h"
 
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <string.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "benchmark.h"
 #include "cpu.h"
 
+#include "cpuaffinity.h"
+#include "metrics.h"
+#include "overlay.h"
+#include "rotation.h"
+#include "simdkernels.h"
+#include "trace.h"
+
 static inline float intersection_area(const FaceObject& a, const FaceObject& b)
 {
     cv::Rect_<float> inter = a.rect & b.rect;
@@ -64,7 +76,7 @@ static void qsort_descent_inplace(std::vector<FaceObject>& faceobjects, int left
     }
 }
 
-static void qsort_descent_inplace(std::vector<FaceObject>& faceobjects)
+void qsort_descent_inplace(std::vector<FaceObject>& faceobjects)
 {
     if (faceobjects.empty())
         return;
@@ -72,42 +84,46 @@ static void qsort_descent_inplace(std::vector<FaceObject>& faceobjects)
     qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
 }
 
-static void nms_sorted_bboxes(const std::vector<FaceObject>& faceobjects, std::vector<int>& picked, float nms_threshold)
+void nms_sorted_bboxes(const std::vector<FaceObject>& faceobjects, std::vector<int>& picked, std::vector<float>& areas, float nms_threshold)
 {
     picked.clear();
 
     const int n = faceobjects.size();
 
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
-    {
-        areas[i] = faceobjects[i].rect.area();
-    }
+    // picked boxes as x0 y0 x1 y1 area arrays for the vector iou
+    areas.resize(n * 5);
+    float* px0 = areas.data();
+    float* py0 = px0 + n;
+    float* px1 = py0 + n;
+    float* py1 = px1 + n;
+    float* pareas = py1 + n;
+
+    const SimdKernels& simd = simd_kernels();
 
     for (int i = 0; i < n; i++)
     {
         const FaceObject& a = faceobjects[i];
 
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const FaceObject& b = faceobjects[picked[j]];
+        const float box[4] = {a.rect.x, a.rect.y, a.rect.x + a.rect.width, a.rect.y + a.rect.height};
+        const float area = a.rect.area();
 
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            //             float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
+        // intersection over union
+        const int count = (int)picked.size();
+        if (simd.iou_any_above(px0, py0, px1, py1, pareas, count, box, area, nms_threshold))
+            continue;
+
+        px0[count] = box[0];
+        py0[count] = box[1];
+        px1[count] = box[2];
+        py1[count] = box[3];
+        pareas[count] = area;
 
-        if (keep)
-            picked.push_back(i);
+        picked.push_back(i);
     }
 }
 
 // insightface/detection/scrfd/mmdet/core/anchor/anchor_generator.py gen_single_level_base_anchors()
-static ncnn::Mat generate_anchors(int base_size, const ncnn::Mat& ratios, const ncnn::Mat& scales)
+ncnn::Mat generate_anchors(int base_size, const ncnn::Mat& ratios, const ncnn::Mat& scales)
 {
     int num_ratio = ratios.w;
     int num_scale = scales.w;
@@ -144,224 +160,931 @@ static ncnn::Mat generate_anchors(int base_size, const ncnn::Mat& ratios, const
     return anchors;
 }
 
-static void generate_proposals(const ncnn::Mat& anchors, int feat_stride, const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, const ncnn::Mat& kps_blob, float prob_threshold, std::vector<FaceObject>& faceobjects)
+// scrfd head layout, one entry per stride
+// insightface/detection/scrfd/configs/scrfd/scrfd_500m.py anchor_generator
+struct SCRFDHeadDesc
 {
-    int w = score_blob.w;
-    int h = score_blob.h;
+    int stride;
+    int base_size;
+    int num_anchors;
+    // face long side in net input pixels this head detects, half the smallest anchor to twice the largest
+    int min_size;
+    int max_size;
+    const char* score_name;
+    const char* bbox_name;
+    const char* kps_name;
+};
+
+static const SCRFDHeadDesc scrfd_heads[3] = {
+    {8, 16, 2, 8, 64, "score_8", "bbox_8", "kps_8"},
+    {16, 64, 2, 32, 256, "score_16", "bbox_16", "kps_16"},
+    {32, 256, 2, 128, INT_MAX, "score_32", "bbox_32", "kps_32"}
+};
+
+// NUM_ANCHORS = 0 takes the anchor count from anchors at runtime
+template<int NUM_ANCHORS, bool KPS>
+static void decode_head(const ncnn::Mat& anchors, int feat_stride, const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, const ncnn::Mat& kps_blob, float prob_threshold, std::vector<FaceObject>& faceobjects)
+{
+    const int w = score_blob.w;
+    const int h = score_blob.h;
+    const int size = w * h;
 
     // generate face proposal from bbox deltas and shifted anchors
-    const int num_anchors = anchors.h;
+    const int num_anchors = NUM_ANCHORS > 0 ? NUM_ANCHORS : anchors.h;
+
+    const SimdKernels& simd = simd_kernels();
 
     for (int q = 0; q < num_anchors; q++)
     {
         const float* anchor = anchors.row(q);
 
-        const ncnn::Mat score = score_blob.channel(q);
-        const ncnn::Mat bbox = bbox_blob.channel_range(q * 4, 4);
+        const float* score = score_blob.channel(q);
+        const float* bbox[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bbox[k] = bbox_blob.channel(q * 4 + k);
+        }
+
+        const float* kps[10];
+        if (KPS)
+        {
+            for (int k = 0; k < 10; k++)
+            {
+                kps[k] = kps_blob.channel(q * 10 + k);
+            }
+        }
 
         // shifted anchor
-        float anchor_y = anchor[1];
+        const float anchor_w = anchor[2] - anchor[0];
+        const float anchor_h = anchor[3] - anchor[1];
+        const float anchor_cx = anchor[0] + anchor_w * 0.5f;
+        const float anchor_cy = anchor[1] + anchor_h * 0.5f;
 
-        float anchor_w = anchor[2] - anchor[0];
-        float anchor_h = anchor[3] - anchor[1];
+        // select and decode in chunks on the stack, no allocation per head
+        const int chunk = 256;
+        int indices[chunk];
+        float boxes[chunk * 4];
 
-        for (int i = 0; i < h; i++)
+        for (int start = 0; start < size; start += chunk)
         {
-            float anchor_x = anchor[0];
+            const int count = simd.select_scores(score + start, std::min(chunk, size - start), prob_threshold, indices);
+            if (count == 0)
+                continue;
 
-            for (int j = 0; j < w; j++)
-            {
-                int index = i * w + j;
+            for (int c = 0; c < count; c++)
+                indices[c] += start;
 
-                float prob = score[index];
+            // insightface/detection/scrfd/mmdet/core/bbox/transforms.py distance2bbox()
+            simd.decode_boxes(bbox, indices, count, w, anchor_cx, anchor_cy, (float)feat_stride, boxes);
 
-                if (prob >= prob_threshold)
+            for (int c = 0; c < count; c++)
+            {
+                const int index = indices[c];
+                const float* box = boxes + c * 4;
+
+                FaceObject obj;
+                obj.rect.x = box[0];
+                obj.rect.y = box[1];
+                obj.rect.width = box[2] - box[0] + 1;
+                obj.rect.height = box[3] - box[1] + 1;
+                obj.prob = score[index];
+                obj.landmark_state = FaceObject::LANDMARK_FRESH;
+
+                if (KPS)
                 {
                     // insightface/detection/scrfd/mmdet/models/dense_heads/scrfd_head.py _get_bboxes_single()
-                    float dx = bbox.channel(0)[index] * feat_stride;
-                    float dy = bbox.channel(1)[index] * feat_stride;
-                    float dw = bbox.channel(2)[index] * feat_stride;
-                    float dh = bbox.channel(3)[index] * feat_stride;
-
-                    // insightface/detection/scrfd/mmdet/core/bbox/transforms.py distance2bbox()
-                    float cx = anchor_x + anchor_w * 0.5f;
-                    float cy = anchor_y + anchor_h * 0.5f;
-
-                    float x0 = cx - dx;
-                    float y0 = cy - dy;
-                    float x1 = cx + dw;
-                    float y1 = cy + dh;
-
-                    FaceObject obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0 + 1;
-                    obj.rect.height = y1 - y0 + 1;
-                    obj.prob = prob;
-
-                    if (!kps_blob.empty())
+                    const int i = index / w;
+                    const int j = index - i * w;
+
+                    const float cx = anchor_cx + j * feat_stride;
+                    const float cy = anchor_cy + i * feat_stride;
+
+                    for (int k = 0; k < 5; k++)
                     {
-                        const ncnn::Mat kps = kps_blob.channel_range(q * 10, 10);
-
-                        obj.landmark[0].x = cx + kps.channel(0)[index] * feat_stride;
-                        obj.landmark[0].y = cy + kps.channel(1)[index] * feat_stride;
-                        obj.landmark[1].x = cx + kps.channel(2)[index] * feat_stride;
-                        obj.landmark[1].y = cy + kps.channel(3)[index] * feat_stride;
-                        obj.landmark[2].x = cx + kps.channel(4)[index] * feat_stride;
-                        obj.landmark[2].y = cy + kps.channel(5)[index] * feat_stride;
-                        obj.landmark[3].x = cx + kps.channel(6)[index] * feat_stride;
-                        obj.landmark[3].y = cy + kps.channel(7)[index] * feat_stride;
-                        obj.landmark[4].x = cx + kps.channel(8)[index] * feat_stride;
-                        obj.landmark[4].y = cy + kps.channel(9)[index] * feat_stride;
+                        obj.landmark[k].x = cx + kps[k * 2][index] * feat_stride;
+                        obj.landmark[k].y = cy + kps[k * 2 + 1][index] * feat_stride;
                     }
-
-                    faceobjects.push_back(obj);
                 }
 
-                anchor_x += feat_stride;
+                faceobjects.push_back(obj);
             }
+        }
+    }
+}
+
+void generate_proposals(const ncnn::Mat& anchors, int feat_stride, const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, const ncnn::Mat& kps_blob, float prob_threshold, std::vector<FaceObject>& faceobjects)
+{
+    const bool kps = !kps_blob.empty();
+
+    if (anchors.h == 2)
+    {
+        if (kps)
+            decode_head<2, true>(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects);
+        else
+            decode_head<2, false>(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects);
+    }
+    else
+    {
+        if (kps)
+            decode_head<0, true>(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects);
+        else
+            decode_head<0, false>(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects);
+    }
+}
+
+static int net_blob_index(const ncnn::Net& net, const char* name)
+{
+    const std::vector<ncnn::Blob>& blobs = net.blobs();
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        if (blobs[i].name == name)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+static void resolve_detector_blobs(const ncnn::Net& net, SCRFDBlobIds& ids)
+{
+    ids.input = net_blob_index(net, "input.1");
+    for (int i = 0; i < 3; i++)
+    {
+        ids.score[i] = net_blob_index(net, scrfd_heads[i].score_name);
+        ids.bbox[i] = net_blob_index(net, scrfd_heads[i].bbox_name);
+        ids.kps[i] = net_blob_index(net, scrfd_heads[i].kps_name);
+    }
+}
 
-            anchor_y += feat_stride;
+static void resolve_landmark_blobs(const ncnn::Net& net, SCRFDBlobIds& ids)
+{
+    ids.landmark_input = net_blob_index(net, "data");
+    ids.landmark_output = net_blob_index(net, "fc1");
+}
+
+#if SCRFD_EMBED_MODELS
+// binary param, weights and blob indices of a compiled-in model
+struct SCRFDEmbeddedModel
+{
+    // modeltype, or 2d106det for the landmark net
+    const char* name;
+    const unsigned char* param_bin;
+    const unsigned char* model_bin;
+    int input;
+    // score bbox kps of stride 8 16 32, -1 when absent, fc1 first for the landmark net
+    int outputs[9];
+};
+
+// generated from ncnn2mem output at configure time, see CMakeLists.txt
+#include "scrfdmodels.h"
+
+static const SCRFDEmbeddedModel* find_embedded_model(const char* name)
+{
+    for (int i = 0; i < scrfd_embedded_model_count; i++)
+    {
+        if (strcmp(scrfd_embedded_models[i].name, name) == 0)
+            return &scrfd_embedded_models[i];
+    }
+
+    return 0;
+}
+#endif // SCRFD_EMBED_MODELS
+
+// load the compiled-in copy from memory, false when it was not embedded
+static bool load_embedded_detector(ncnn::Net& net, const char* modeltype, SCRFDBlobIds& ids)
+{
+#if SCRFD_EMBED_MODELS
+    const SCRFDEmbeddedModel* m = find_embedded_model(modeltype);
+    if (!m)
+        return false;
+
+    if (net.load_param(m->param_bin) == 0 || net.load_model(m->model_bin) == 0)
+        return false;
+
+    ids.input = m->input;
+    for (int i = 0; i < 3; i++)
+    {
+        ids.score[i] = m->outputs[i * 3];
+        ids.bbox[i] = m->outputs[i * 3 + 1];
+        ids.kps[i] = m->outputs[i * 3 + 2];
+    }
+
+    return true;
+#else
+    (void)net;
+    (void)modeltype;
+    (void)ids;
+    return false;
+#endif // SCRFD_EMBED_MODELS
+}
+
+static bool load_embedded_landmark(ncnn::Net& net, SCRFDBlobIds& ids)
+{
+#if SCRFD_EMBED_MODELS
+    const SCRFDEmbeddedModel* m = find_embedded_model("2d106det");
+    if (!m)
+        return false;
+
+    if (net.load_param(m->param_bin) == 0 || net.load_model(m->model_bin) == 0)
+        return false;
+
+    ids.landmark_input = m->input;
+    ids.landmark_output = m->outputs[0];
+
+    return true;
+#else
+    (void)net;
+    (void)ids;
+    return false;
+#endif // SCRFD_EMBED_MODELS
+}
+
+SCRFDNetConfig::SCRFDNetConfig()
+{
+    ncnn::Option opt;
+    use_fp16_packed = opt.use_fp16_packed;
+    use_fp16_storage = opt.use_fp16_storage;
+    use_fp16_arithmetic = opt.use_fp16_arithmetic;
+    use_packing_layout = opt.use_packing_layout;
+    use_winograd_convolution = opt.use_winograd_convolution;
+    use_sgemm_convolution = opt.use_sgemm_convolution;
+    lightmode = opt.lightmode;
+
+    num_threads = 0;
+    powersave = 2;
+}
+
+void SCRFDNetConfig::apply(ncnn::Option& opt) const
+{
+    opt.use_fp16_packed = use_fp16_packed;
+    opt.use_fp16_storage = use_fp16_storage;
+    opt.use_fp16_arithmetic = use_fp16_arithmetic;
+    opt.use_packing_layout = use_packing_layout;
+    opt.use_winograd_convolution = use_winograd_convolution;
+    opt.use_sgemm_convolution = use_sgemm_convolution;
+    opt.lightmode = lightmode;
+
+    opt.num_threads = num_threads > 0 ? num_threads : ncnn::get_big_cpu_count();
+}
+
+int SCRFDNetConfig::to_flags() const
+{
+    int flags = 0;
+    if (use_fp16_packed) flags |= FP16_PACKED;
+    if (use_fp16_storage) flags |= FP16_STORAGE;
+    if (use_fp16_arithmetic) flags |= FP16_ARITHMETIC;
+    if (use_packing_layout) flags |= PACKING_LAYOUT;
+    if (use_winograd_convolution) flags |= WINOGRAD;
+    if (use_sgemm_convolution) flags |= SGEMM;
+    if (lightmode) flags |= LIGHTMODE;
+    return flags;
+}
+
+void SCRFDNetConfig::from_flags(int flags)
+{
+    use_fp16_packed = flags & FP16_PACKED;
+    use_fp16_storage = flags & FP16_STORAGE;
+    use_fp16_arithmetic = flags & FP16_ARITHMETIC;
+    use_packing_layout = flags & PACKING_LAYOUT;
+    use_winograd_convolution = flags & WINOGRAD;
+    use_sgemm_convolution = flags & SGEMM;
+    lightmode = flags & LIGHTMODE;
+}
+
+static void generate_stride_anchors(ncnn::Mat anchors[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        const SCRFDHeadDesc& head = scrfd_heads[i];
+
+        // ratio 1, scales 1 2 4 .. doubling per anchor
+        ncnn::Mat ratios(1);
+        ratios[0] = 1.f;
+        ncnn::Mat scales(head.num_anchors);
+        for (int j = 0; j < head.num_anchors; j++)
+        {
+            scales[j] = (float)(1 << j);
         }
+
+        anchors[i] = generate_anchors(head.base_size, ratios, scales);
     }
 }
 
-int SCRFD::load(const char* modeltype, bool use_gpu) //不运行
+SCRFDConfig::SCRFDConfig()
+{
+    // insightface/detection/scrfd/configs/scrfd/scrfd_500m.py
+    target_size = 120;
+
+    min_face_size = 0;
+    max_face_size = 0;
+
+    landmark_budget_ms = 0.f;
+    landmark_priority = LANDMARK_BY_AREA;
+}
+
+int SCRFD::load(const char* modeltype, bool use_gpu, const SCRFDConfig& _config) //不运行
 {
     scrfd.clear();
     landmarks.clear(); //清除关键点模型
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+    config = _config;
 
     scrfd.opt = ncnn::Option();
+    config.detector.apply(scrfd.opt);
 
 #if NCNN_VULKAN
     scrfd.opt.use_vulkan_compute = use_gpu;
 #endif
 
-    scrfd.opt.num_threads = ncnn::get_big_cpu_count();
+    if (!load_embedded_detector(scrfd, modeltype, blob_ids))
+    {
+        char parampath[256];
+        char modelpath[256];
+        sprintf(parampath, "scrfd_%s-opt2.param", modeltype);
+        sprintf(modelpath, "scrfd_%s-opt2.bin", modeltype);
+
+        scrfd.load_param(parampath);
+        scrfd.load_model(modelpath);
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "scrfd_%s-opt2.param", modeltype);
-    sprintf(modelpath, "scrfd_%s-opt2.bin", modeltype);
+        resolve_detector_blobs(scrfd, blob_ids);
+    }
+
+    has_kps = blob_ids.kps[0] >= 0;
 
-    scrfd.load_param(parampath);
-    scrfd.load_model(modelpath);
+    generate_stride_anchors(anchors);
 
-    has_kps = strstr(modeltype, "_kps") != NULL;
+    if (landmark_owner)
+        return 0;
 
-    landmarks.load_param("assets/2d106det_change.param"); //加载关键点模型
-    landmarks.load_model("assets/2d106det_change.bin");
+    // 加载关键点模型设置, 与检测模型放在同一目录
+    landmarks.opt = ncnn::Option();
+    config.landmark.apply(landmarks.opt);
+    if (!load_embedded_landmark(landmarks, blob_ids))
+    {
+        landmarks.load_param("2d106det_change.param"); //加载关键点模型
+        landmarks.load_model("2d106det_change.bin");
+
+        resolve_landmark_blobs(landmarks, blob_ids);
+    }
 
     return 0;
 }
 
-int SCRFD::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+#if __ANDROID_API__ >= 9
+int SCRFD::load(AAssetManager* mgr, const char* modeltype, bool use_gpu, const SCRFDConfig& _config)
 {
     scrfd.clear();
     landmarks.clear(); //清除关键点模型
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+    config = _config;
 
     scrfd.opt = ncnn::Option();
+    config.detector.apply(scrfd.opt);
 
 #if NCNN_VULKAN
     scrfd.opt.use_vulkan_compute = use_gpu;
 #endif
 
-    scrfd.opt.num_threads = ncnn::get_big_cpu_count();
+    if (!load_embedded_detector(scrfd, modeltype, blob_ids))
+    {
+        char parampath[256];
+        char modelpath[256];
+        sprintf(parampath, "scrfd_%s-opt2.param", modeltype);
+        sprintf(modelpath, "scrfd_%s-opt2.bin", modeltype);
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "scrfd_%s-opt2.param", modeltype);
-    sprintf(modelpath, "scrfd_%s-opt2.bin", modeltype);
+        scrfd.load_param(mgr, parampath);
+        scrfd.load_model(mgr, modelpath);
 
-    scrfd.load_param(mgr, parampath);
-    scrfd.load_model(mgr, modelpath);
+        resolve_detector_blobs(scrfd, blob_ids);
+    }
 
-    has_kps = strstr(modeltype, "_kps") != NULL;
+    has_kps = blob_ids.kps[0] >= 0;
+
+    generate_stride_anchors(anchors);
 
     // 加载关键点模型设置
+    if (landmark_owner)
+        return 0;
+
     landmarks.opt = ncnn::Option();
+    config.landmark.apply(landmarks.opt);
     //landmarks.opt.use_vulkan_compute = true;
-    landmarks.opt.num_threads = ncnn::get_big_cpu_count();
-    landmarks.load_param(mgr,"2d106det_change.param"); //加载关键点模型权重
-    landmarks.load_model(mgr,"2d106det_change.bin");
+    if (!load_embedded_landmark(landmarks, blob_ids))
+    {
+        landmarks.load_param(mgr,"2d106det_change.param"); //加载关键点模型权重
+        landmarks.load_model(mgr,"2d106det_change.bin");
+
+        resolve_landmark_blobs(landmarks, blob_ids);
+    }
 
     return 0;
 }
+#endif // __ANDROID_API__ >= 9
+
+void SCRFD::set_threads(int det_threads, int det_powersave, int lmk_threads, int lmk_powersave)
+{
+    config.detector.num_threads = det_threads;
+    config.detector.powersave = det_powersave;
+    config.landmark.num_threads = lmk_threads;
+    config.landmark.powersave = lmk_powersave;
+
+    scrfd.opt.num_threads = det_threads > 0 ? det_threads : ncnn::get_big_cpu_count();
+    if (!landmark_owner)
+        landmarks.opt.num_threads = lmk_threads > 0 ? lmk_threads : ncnn::get_big_cpu_count();
+}
+
+int SCRFD::bind_thread() const
+{
+    return set_inference_affinity(config.detector.powersave);
+}
+
+static double benchmark_net(const ncnn::Net& net, int input, const ncnn::Mat& in, const int* outputs, int output_count, int num_threads, int powersave, int loops)
+{
+    // give the caller its cores back afterwards, all cores when it was never bound
+    const int previous_powersave = get_inference_affinity();
+    set_inference_affinity(powersave);
+
+    double total = 0;
+    for (int i = -1; i < loops; i++)
+    {
+        double start = ncnn::get_current_time();
+
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_num_threads(num_threads);
+        ex.input(input, in);
+
+        for (int j = 0; j < output_count; j++)
+        {
+            ncnn::Mat out;
+            ex.extract(outputs[j], out);
+        }
+
+        double end = ncnn::get_current_time();
+
+        // first run is warmup
+        if (i >= 0)
+            total += end - start;
+    }
+
+    set_inference_affinity(previous_powersave >= 0 ? previous_powersave : 0);
+
+    return total / loops;
+}
+
+double SCRFD::benchmark_detector(int num_threads, int powersave, int loops)
+{
+    // 640x480 frame at target_size 120, padded
+    ncnn::Mat in(128, 96, 3);
+    in.fill(0.f);
+
+    int outputs[9];
+    int output_count = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        outputs[output_count++] = blob_ids.score[i];
+        outputs[output_count++] = blob_ids.bbox[i];
+        if (has_kps)
+            outputs[output_count++] = blob_ids.kps[i];
+    }
+
+    return benchmark_net(scrfd, blob_ids.input, in, outputs, output_count, num_threads, powersave, loops);
+}
+
+double SCRFD::benchmark_landmark(int num_threads, int powersave, int loops)
+{
+    ncnn::Mat in(192, 192, 3);
+    in.fill(0.f);
+
+    const SCRFD& source = landmark_source();
+
+    return benchmark_net(source.landmarks, source.blob_ids.landmark_input, in, &source.blob_ids.landmark_output, 1, num_threads, powersave, loops);
+}
 
 /* 人脸关键点前处理*/
-return_d_m pre_process(const cv::Mat& src, int input_size, FaceObject& det){
-    cv::Mat dst;
-    return_d_m dst_m3;
+// crop the face into dst, affine is the 2x3 row major transform from image to crop
+void pre_process(const cv::Mat& src, int input_size, const FaceObject& det, cv::Mat& dst, double affine[6])
+{
+    pre_process(src, 1, input_size, det, dst, affine);
+}
+
+void pre_process(const cv::Mat& src, int rotate_type, int input_size, const FaceObject& det, cv::Mat& dst, double affine[6])
+{
     int x1 = det.rect.x;
     int y1 = det.rect.y;
     int faceImgWidth = det.rect.width;
     int faceImgHeight = det.rect.height;
-//    NCNN_LOGE("x1 = %d",x1);
-//    NCNN_LOGE("y1 = %d",y1);
-//    NCNN_LOGE("w = %d",faceImgWidth);
-//    NCNN_LOGE("h = %d",faceImgHeight);
     float center_w = x1+faceImgWidth/2;
     float center_h = y1+faceImgHeight/2;
 
-
     double _scale = input_size / (MAX(faceImgWidth, faceImgHeight) * 1.5);
 
-    //构建仿射变换矩阵矩阵
-    cv::Mat m1 = cv::Mat::eye(cv::Size(3,2),CV_64F);
-    m1 *= _scale; //缩放矩阵
-    cv::Mat m2 = cv::Mat::zeros(cv::Size(3,2),CV_64F);
-    m2.at<double >(0,2) = -(center_w * _scale) + input_size/2;
-    m2.at<double >(1,2) = -(center_h * _scale) + input_size/2; //平移矩阵
-    dst_m3.matri = m1 + m2;
-    cv::warpAffine(src, dst_m3.dst,  dst_m3.matri, cv::Size(192,192));
+    //构建仿射变换矩阵, 缩放加平移
+    affine[0] = _scale;
+    affine[1] = 0;
+    affine[2] = -(center_w * _scale) + input_size/2;
+    affine[3] = 0;
+    affine[4] = _scale;
+    affine[5] = -(center_h * _scale) + input_size/2;
+
+    if (rotate_type == 1)
+    {
+        cv::Mat matri(2, 3, CV_64F, affine);
+        cv::warpAffine(src, dst, matri, cv::Size(input_size, input_size));
+        return;
+    }
 
-    return dst_m3;
+    // sample the crop straight from the sensor frame, upright to crop after sensor to upright
+    double r[6];
+    rotate_type_affine(rotate_type, src.cols, src.rows, r);
+
+    double warp[6];
+    warp[0] = affine[0] * r[0] + affine[1] * r[3];
+    warp[1] = affine[0] * r[1] + affine[1] * r[4];
+    warp[2] = affine[0] * r[2] + affine[1] * r[5] + affine[2];
+    warp[3] = affine[3] * r[0] + affine[4] * r[3];
+    warp[4] = affine[3] * r[1] + affine[4] * r[4];
+    warp[5] = affine[3] * r[2] + affine[4] * r[5] + affine[5];
+
+    cv::Mat matri(2, 3, CV_64F, warp);
+    cv::warpAffine(src, dst, matri, cv::Size(input_size, input_size));
 }
 
 /*人脸关键点后处理*/
-cv::Mat post_progress (cv::Mat& post_mat, cv::Mat& m){
-    cv::Mat im;
-    cv::Mat pts(106, 2, CV_32F);
-    cv::Mat new_pts;
-    cv::Mat im_t;
-    cv::Mat im_t_f;
-    cv::Mat coord;
-    cv::Mat col_cat = cv::Mat::ones(106,1,CV_32F);
+// output holds 106 (x, y) in [-1, 1] of the crop, map them back to the image through the inverse affine
+void post_progress(const float* output, int input_size, const double affine[6], cv::Point2f* coord)
+{
+    // cv::invertAffineTransform
+    double D = affine[0] * affine[4] - affine[1] * affine[3];
+    D = D != 0 ? 1. / D : 0;
+    const float A11 = affine[4] * D;
+    const float A22 = affine[0] * D;
+    const float A12 = -affine[1] * D;
+    const float A21 = -affine[3] * D;
+    const float b1 = -A11 * affine[2] - A12 * affine[5];
+    const float b2 = -A21 * affine[2] - A22 * affine[5];
+
+    const float half = input_size / 2;
+
+    const float m[6] = {A11, A12, b1, A21, A22, b2};
+    simd_kernels().affine_points(output, 106, half, m, (float*)coord);
+}
 
-    int index = 0;
-    for (int i = 0; i < 106; ++i) {
-        for (int j = 0; j < 2; ++j){
-            pts.at<float>(i,j) = post_mat.at<float>(index,0);
-            index ++;
+FrameResult::FaceView FrameResult::face(int i) const
+{
+    FaceView view;
+    view.object = &faceobjects[i];
+    view.landmarks = has_landmarks() ? &landmarks[i * 106] : 0;
+    return view;
+}
+
+void FrameResult::to_mats(std::vector<cv::Mat>& facelandmarks) const
+{
+    facelandmarks.clear();
+    if (!has_landmarks())
+        return;
+
+    for (int i = 0; i < face_count(); i++)
+    {
+        cv::Mat coord(106, 2, CV_32F);
+        memcpy(coord.data, &landmarks[i * 106], 106 * sizeof(cv::Point2f));
+        facelandmarks.push_back(coord);
+    }
+}
+
+void FrameResult::from_mats(const std::vector<FaceObject>& _faceobjects, const std::vector<cv::Mat>& facelandmarks)
+{
+    faceobjects = _faceobjects;
+    landmarks.clear();
+    if (facelandmarks.size() < faceobjects.size())
+        return;
+
+    landmarks.resize(faceobjects.size() * 106);
+    for (int i = 0; i < face_count(); i++)
+    {
+        const cv::Mat& m = facelandmarks[i];
+        for (int j = 0; j < 106 && j < m.rows; j++)
+        {
+            landmarks[i * 106 + j] = cv::Point2f(m.at<float>(j, 0), m.at<float>(j, 1));
+        }
+    }
+}
+
+// index of the previous frame face overlapping obj the most, -1 if none above iou 0.3
+static int match_previous_face(const FaceObject& obj, const std::vector<FaceObject>& prev_faceobjects)
+{
+    int best = -1;
+    float best_iou = 0.3f;
+    for (int j = 0; j < (int)prev_faceobjects.size(); j++)
+    {
+        float inter_area = intersection_area(obj, prev_faceobjects[j]);
+        float union_area = obj.rect.area() + prev_faceobjects[j].rect.area() - inter_area;
+        float iou = union_area > 0.f ? inter_area / union_area : 0.f;
+        if (iou > best_iou)
+        {
+            best = j;
+            best_iou = iou;
         }
     }
 
-    invertAffineTransform(m, im);
-    pts += 1;
-    pts *= 192/2;
+    return best;
+}
+
+// order faces for landmarks, faces that missed the previous frame first, then by area or prob
+static void schedule_landmarks(const std::vector<FaceObject>& faceobjects, int priority, DetectionWorkspace& ws)
+{
+    const int face_count = faceobjects.size();
+
+    ws.landmark_order.resize(face_count);
+    ws.landmark_match.resize(face_count);
+    ws.landmark_keys.resize(face_count);
+
+    for (int i = 0; i < face_count; i++)
+    {
+        const FaceObject& obj = faceobjects[i];
+
+        int match = match_previous_face(obj, ws.prev_faceobjects);
+        ws.landmark_match[i] = match;
+
+        float key = priority == SCRFDConfig::LANDMARK_BY_PROB ? obj.prob : obj.rect.area();
+        if (match >= 0 && ws.prev_faceobjects[match].landmark_state != FaceObject::LANDMARK_FRESH)
+            key += 1e9f;
+
+        ws.landmark_keys[i] = key;
+        ws.landmark_order[i] = i;
+    }
+
+    const std::vector<float>& keys = ws.landmark_keys;
+    for (int i = 1; i < face_count; i++)
+    {
+        // insertion sort, face counts are small
+        int idx = ws.landmark_order[i];
+        int j = i - 1;
+        while (j >= 0 && keys[ws.landmark_order[j]] < keys[idx])
+        {
+            ws.landmark_order[j + 1] = ws.landmark_order[j];
+            j--;
+        }
+        ws.landmark_order[j + 1] = idx;
+    }
+}
 
-    cv::hconcat(pts, col_cat, new_pts);
+SCRFDContext::SCRFDContext()
+{
+    detector_threads = 0;
+    landmark_threads = 0;
+    target_size = 0;
+}
 
-    transpose(im, im_t);
-    im_t.convertTo(im_t_f,CV_32F);
-    coord = new_pts * im_t_f;
+int SCRFD::detect(const cv::Mat& rgb, FrameResult& result, float prob_threshold, float nms_threshold)
+{
+    return detect(default_context, rgb, 1, result, prob_threshold, nms_threshold);
+}
 
-    return coord;
+int SCRFD::detect(const cv::Mat& rgb, int rotate_type, FrameResult& result, float prob_threshold, float nms_threshold)
+{
+    return detect(default_context, rgb, rotate_type, result, prob_threshold, nms_threshold);
 }
 
 int SCRFD::detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std::vector<cv::Mat>& facelandmarks,float prob_threshold, float nms_threshold)
 {
+    return detect(default_context, rgb, faceobjects, facelandmarks, prob_threshold, nms_threshold);
+}
+
+int SCRFD::detect(SCRFDContext& ctx, const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std::vector<cv::Mat>& facelandmarks, float prob_threshold, float nms_threshold) const
+{
+    FrameResult result;
+    int ret = detect(ctx, rgb, result, prob_threshold, nms_threshold);
+
+    faceobjects = result.faceobjects;
+    result.to_mats(facelandmarks);
+
+    return ret;
+}
+
+// merge inclusion regions where one crop costs no more pixels than two
+static void merge_regions(const std::vector<cv::Rect>& regions, int width, int height, std::vector<cv::Rect>& merged)
+{
+    merged.clear();
+
+    const cv::Rect frame(0, 0, width, height);
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        cv::Rect r = regions[i] & frame;
+        if (r.area() > 0)
+            merged.push_back(r);
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t i = 0; i < merged.size() && !changed; i++)
+        {
+            for (size_t j = i + 1; j < merged.size(); j++)
+            {
+                const cv::Rect u = merged[i] | merged[j];
+                if (u.area() <= merged[i].area() + merged[j].area())
+                {
+                    merged[i] = u;
+                    merged.erase(merged.begin() + j);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static bool in_excluded_region(const FaceObject& obj, const std::vector<cv::Rect>& exclude_regions)
+{
+    const float cx = obj.rect.x + obj.rect.width * 0.5f;
+    const float cy = obj.rect.y + obj.rect.height * 0.5f;
+    for (size_t i = 0; i < exclude_regions.size(); i++)
+    {
+        const cv::Rect& r = exclude_regions[i];
+        if (cx >= r.x && cx < r.x + r.width && cy >= r.y && cy < r.y + r.height)
+            return true;
+    }
+
+    return false;
+}
+
+// same values as from_pixels + substract_mean_normalize
+static const float scrfd_mean_val = 127.5f;
+static const float scrfd_norm_val = 1 / 128.f;
+
+// normalize w x h rgb pixels into the planar detector input at left, top
+static void normalize_into(const unsigned char* pixels, int w, int h, ncnn::Mat& in_pad, int left, int top)
+{
+    for (int q = 0; q < 3; q++)
+    {
+        ncnn::Mat plane = in_pad.channel(q);
+
+        for (int y = 0; y < h; y++)
+        {
+            const unsigned char* ptr = pixels + y * w * 3 + q;
+            float* outptr = plane.row(top + y) + left;
+            for (int x = 0; x < w; x++)
+            {
+                outptr[x] = (ptr[0] - scrfd_mean_val) * scrfd_norm_val;
+                ptr += 3;
+            }
+        }
+    }
+}
+
+double SCRFD::extract_proposals(SCRFDContext& ctx, float min_size, float max_size, float prob_threshold) const
+{
+    DetectionWorkspace& ws = ctx.workspace;
+
+    ncnn::Extractor ex = scrfd.create_extractor();
+    ex.set_blob_allocator(&ctx.blob_allocator);
+    ex.set_workspace_allocator(&ctx.workspace_allocator);
+    if (ctx.detector_threads > 0)
+        ex.set_num_threads(ctx.detector_threads);
+
+    ex.input(blob_ids.input, ws.in_pad);
+
+    double extract_ms = 0;
+    double decode_ms = 0;
+
+    // stride 8 16 32
+    for (int i = 0; i < 3; i++)
+    {
+        const SCRFDHeadDesc& head = scrfd_heads[i];
+
+        // unextracted heads are never computed by ncnn
+        if (head.max_size < min_size || head.min_size > max_size)
+            continue;
+
+        double t0 = ncnn::get_current_time();
+
+        {
+            SCRFD_TRACE_SCOPE("detect_extract");
+
+            ex.extract(blob_ids.score[i], ws.score_blobs[i]);
+            ex.extract(blob_ids.bbox[i], ws.bbox_blobs[i]);
+            if (has_kps)
+                ex.extract(blob_ids.kps[i], ws.kps_blobs[i]);
+            else
+                ws.kps_blobs[i].release();
+        }
+
+        double t1 = ncnn::get_current_time();
+
+        {
+            SCRFD_TRACE_SCOPE("decode");
+
+            generate_proposals(anchors[i], head.stride, ws.score_blobs[i], ws.bbox_blobs[i], ws.kps_blobs[i], prob_threshold, ws.proposals);
+        }
+
+        extract_ms += t1 - t0;
+        decode_ms += ncnn::get_current_time() - t1;
+    }
+
+    metrics_record(METRIC_DETECT_EXTRACT, extract_ms);
+
+    return decode_ms;
+}
+
+void SCRFD::detect_region(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, int w, int h, float scale, const cv::Point& offset, float prob_threshold) const
+{
+    DetectionWorkspace& ws = ctx.workspace;
+
     int width = rgb.cols;
     int height = rgb.rows;
 
-    // insightface/detection/scrfd/configs/scrfd/scrfd_500m.py
-    const int target_size = 120;
+    // pad to target_size rectangle
+    int wpad = (w + 31) / 32 * 32 - w;
+    int hpad = (h + 31) / 32 * 32 - h;
+
+    // resize, pad and normalize into the reused input in one pass
+    // same values as from_pixels_resize + copy_make_border(0) + substract_mean_normalize
+    {
+        SCRFD_TRACE_SCOPE("preprocess");
+
+        ws.resized.resize(w * h * 3);
+        if (rotate_type == 1)
+        {
+            ncnn::resize_bilinear_c3(rgb.data, width, height, (int)rgb.step, ws.resized.data(), w, h, w * 3);
+        }
+        else
+        {
+            // resize in sensor orientation, then rotate only the small image upright
+            int sw = 0;
+            int sh = 0;
+            rotate_type_size(rotate_type, w, h, &sw, &sh);
+
+            ws.sensor_resized.resize(sw * sh * 3);
+            ncnn::resize_bilinear_c3(rgb.data, width, height, (int)rgb.step, ws.sensor_resized.data(), sw, sh, sw * 3);
+            ncnn::kanna_rotate_c3(ws.sensor_resized.data(), sw, sh, ws.resized.data(), w, h, rotate_type);
+        }
+
+        ws.in_pad.create(w + wpad, h + hpad, 3, 4u, &ctx.blob_allocator);
+        ws.in_pad.fill((0.f - scrfd_mean_val) * scrfd_norm_val);
+
+        normalize_into(ws.resized.data(), w, h, ws.in_pad, wpad / 2, hpad / 2);
+    }
+
+    // face size range in net input pixels
+    const float min_size = config.min_face_size > 0 ? config.min_face_size * scale : 0.f;
+    const float max_size = config.max_face_size > 0 ? config.max_face_size * scale : FLT_MAX;
+
+    const size_t first = ws.proposals.size();
+
+    const double decode_ms = extract_proposals(ctx, min_size, max_size, prob_threshold);
+
+    const double t2 = ncnn::get_current_time();
+
+    // filter by size and adjust offset to original unpadded, in rgb coordinates of the whole frame
+    std::vector<FaceObject>& faceproposals = ws.proposals;
+
+    size_t n = first;
+    for (size_t i = first; i < faceproposals.size(); i++)
+    {
+        FaceObject obj = faceproposals[i];
+
+        const float size = std::max(obj.rect.width, obj.rect.height);
+        if (size < min_size || size > max_size)
+            continue;
+
+        obj.rect.x = (obj.rect.x - (wpad / 2)) / scale + offset.x;
+        obj.rect.y = (obj.rect.y - (hpad / 2)) / scale + offset.y;
+        obj.rect.width = obj.rect.width / scale;
+        obj.rect.height = obj.rect.height / scale;
+
+        if (has_kps)
+        {
+            for (int k = 0; k < 5; k++)
+            {
+                obj.landmark[k].x = (obj.landmark[k].x - (wpad / 2)) / scale + offset.x;
+                obj.landmark[k].y = (obj.landmark[k].y - (hpad / 2)) / scale + offset.y;
+            }
+        }
+
+        faceproposals[n++] = obj;
+    }
+    faceproposals.resize(n);
+
+    metrics_record(METRIC_DECODE, decode_ms + ncnn::get_current_time() - t2);
+}
+
+int SCRFD::detect(SCRFDContext& ctx, const cv::Mat& rgb, FrameResult& result, float prob_threshold, float nms_threshold) const
+{
+    return detect(ctx, rgb, 1, result, prob_threshold, nms_threshold);
+}
+
+int SCRFD::detect(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, FrameResult& result, float prob_threshold, float nms_threshold) const
+{
+    SCRFD_TRACE_SCOPE("detect");
+
+    DetectionWorkspace& ws = ctx.workspace;
+
+    // upright size
+    int width = 0;
+    int height = 0;
+    rotate_type_size(rotate_type, rgb.cols, rgb.rows, &width, &height);
+
+    const int target_size = ctx.target_size > 0 ? ctx.target_size : config.target_size;
 
     // pad to multiple of 32
     int w = width;
@@ -380,112 +1103,92 @@ int SCRFD::detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std:
         w = w * scale;
     }
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, width, height, w, h);
+    ws.proposals.clear();
 
-    // pad to target_size rectangle
-    int wpad = (w + 31) / 32 * 32 - w;
-    int hpad = (h + 31) / 32 * 32 - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+    if (config.include_regions.empty())
+    {
+        detect_region(ctx, rgb, rotate_type, w, h, scale, cv::Point(0, 0), prob_threshold);
+    }
+    else
+    {
+        // only the inclusion crops, at the scale of the whole frame
+        merge_regions(config.include_regions, width, height, ws.regions);
 
-    const float mean_vals[3] = {127.5f, 127.5f, 127.5f};
-    const float norm_vals[3] = {1/128.f, 1/128.f, 1/128.f};
-    in_pad.substract_mean_normalize(mean_vals, norm_vals);
+        const int sensor_rotate_type = rotate_type_inverse(rotate_type);
 
-    ncnn::Extractor ex = scrfd.create_extractor();
+        for (size_t i = 0; i < ws.regions.size(); i++)
+        {
+            const cv::Rect& r = ws.regions[i];
 
-    ex.input("input.1", in_pad);
+            int rw = r.width * scale;
+            int rh = r.height * scale;
+            if (rw < 1 || rh < 1)
+                continue;
 
-    std::vector<FaceObject> faceproposals;
+            // the sensor pixels that rotate into r
+            const cv::Rect sr = rotate_rect(sensor_rotate_type, width, height, r);
 
-    // stride 8
-    {
-        ncnn::Mat score_blob, bbox_blob, kps_blob;
-        ex.extract("score_8", score_blob);
-        ex.extract("bbox_8", bbox_blob);
-        if (has_kps)
-            ex.extract("kps_8", kps_blob);
+            detect_region(ctx, rgb(sr), rotate_type, rw, rh, scale, r.tl(), prob_threshold);
+        }
+    }
 
-        const int base_size = 16;
-        const int feat_stride = 8;
-        ncnn::Mat ratios(1);
-        ratios[0] = 1.f;
-        ncnn::Mat scales(2);
-        scales[0] = 1.f;
-        scales[1] = 2.f;
-        ncnn::Mat anchors = generate_anchors(base_size, ratios, scales);
+    finish_detect(ctx, rgb, rotate_type, result, nms_threshold);
 
-        std::vector<FaceObject> faceobjects8;
-        generate_proposals(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects8);
+    return 0;
+}
 
-        faceproposals.insert(faceproposals.end(), faceobjects8.begin(), faceobjects8.end());
-    }
+void SCRFD::finish_detect(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, FrameResult& result, float nms_threshold) const
+{
+    DetectionWorkspace& ws = ctx.workspace;
 
-    // stride 16
-    {
-        ncnn::Mat score_blob, bbox_blob, kps_blob;
-        ex.extract("score_16", score_blob);
-        ex.extract("bbox_16", bbox_blob);
-        if (has_kps)
-            ex.extract("kps_16", kps_blob);
+    std::vector<FaceObject>& faceobjects = result.faceobjects;
+    result.landmarks.clear();
 
-        const int base_size = 64;
-        const int feat_stride = 16;
-        ncnn::Mat ratios(1);
-        ratios[0] = 1.f;
-        ncnn::Mat scales(2);
-        scales[0] = 1.f;
-        scales[1] = 2.f;
-        ncnn::Mat anchors = generate_anchors(base_size, ratios, scales);
+    // upright size
+    int width = 0;
+    int height = 0;
+    rotate_type_size(rotate_type, rgb.cols, rgb.rows, &width, &height);
 
-        std::vector<FaceObject> faceobjects16;
-        generate_proposals(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects16);
+    std::vector<FaceObject>& faceproposals = ws.proposals;
 
-        faceproposals.insert(faceproposals.end(), faceobjects16.begin(), faceobjects16.end());
+    if (!config.exclude_regions.empty())
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < faceproposals.size(); i++)
+        {
+            if (!in_excluded_region(faceproposals[i], config.exclude_regions))
+                faceproposals[n++] = faceproposals[i];
+        }
+        faceproposals.resize(n);
     }
 
-    // stride 32
+    std::vector<int>& picked = ws.picked;
     {
-        ncnn::Mat score_blob, bbox_blob, kps_blob;
-        ex.extract("score_32", score_blob);
-        ex.extract("bbox_32", bbox_blob);
-        if (has_kps)
-            ex.extract("kps_32", kps_blob);
-
-        const int base_size = 256;
-        const int feat_stride = 32;
-        ncnn::Mat ratios(1);
-        ratios[0] = 1.f;
-        ncnn::Mat scales(2);
-        scales[0] = 1.f;
-        scales[1] = 2.f;
-        ncnn::Mat anchors = generate_anchors(base_size, ratios, scales);
+        MetricTimer timer(METRIC_NMS);
+        SCRFD_TRACE_SCOPE("nms");
 
-        std::vector<FaceObject> faceobjects32;
-        generate_proposals(anchors, feat_stride, score_blob, bbox_blob, kps_blob, prob_threshold, faceobjects32);
+        // sort all proposals by score from highest to lowest
+        qsort_descent_inplace(faceproposals);
 
-        faceproposals.insert(faceproposals.end(), faceobjects32.begin(), faceobjects32.end());
+        // apply nms with nms_threshold
+        nms_sorted_bboxes(faceproposals, picked, ws.areas, nms_threshold);
     }
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(faceproposals);
-
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(faceproposals, picked, nms_threshold);
-
     int face_count = picked.size();
 
+    metrics_add(METRIC_FRAMES);
+    metrics_add(METRIC_FACES, face_count);
+
     faceobjects.resize(face_count);
     for (int i = 0; i < face_count; i++)
     {
         faceobjects[i] = faceproposals[picked[i]];
 
-        // adjust offset to original unpadded
-        float x0 = (faceobjects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (faceobjects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (faceobjects[i].rect.x + faceobjects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (faceobjects[i].rect.y + faceobjects[i].rect.height - (hpad / 2)) / scale;
+        // clip to the frame
+        float x0 = faceobjects[i].rect.x;
+        float y0 = faceobjects[i].rect.y;
+        float x1 = faceobjects[i].rect.x + faceobjects[i].rect.width;
+        float y1 = faceobjects[i].rect.y + faceobjects[i].rect.height;
 
         x0 = std::max(std::min(x0, (float)width - 1), 0.f);
         y0 = std::max(std::min(y0, (float)height - 1), 0.f);
@@ -499,88 +1202,318 @@ int SCRFD::detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std:
 
         if (has_kps)
         {
-            float x0 = (faceobjects[i].landmark[0].x - (wpad / 2)) / scale;
-            float y0 = (faceobjects[i].landmark[0].y - (hpad / 2)) / scale;
-            float x1 = (faceobjects[i].landmark[1].x - (wpad / 2)) / scale;
-            float y1 = (faceobjects[i].landmark[1].y - (hpad / 2)) / scale;
-            float x2 = (faceobjects[i].landmark[2].x - (wpad / 2)) / scale;
-            float y2 = (faceobjects[i].landmark[2].y - (hpad / 2)) / scale;
-            float x3 = (faceobjects[i].landmark[3].x - (wpad / 2)) / scale;
-            float y3 = (faceobjects[i].landmark[3].y - (hpad / 2)) / scale;
-            float x4 = (faceobjects[i].landmark[4].x - (wpad / 2)) / scale;
-            float y4 = (faceobjects[i].landmark[4].y - (hpad / 2)) / scale;
-
-            faceobjects[i].landmark[0].x = std::max(std::min(x0, (float)width - 1), 0.f);
-            faceobjects[i].landmark[0].y = std::max(std::min(y0, (float)height - 1), 0.f);
-            faceobjects[i].landmark[1].x = std::max(std::min(x1, (float)width - 1), 0.f);
-            faceobjects[i].landmark[1].y = std::max(std::min(y1, (float)height - 1), 0.f);
-            faceobjects[i].landmark[2].x = std::max(std::min(x2, (float)width - 1), 0.f);
-            faceobjects[i].landmark[2].y = std::max(std::min(y2, (float)height - 1), 0.f);
-            faceobjects[i].landmark[3].x = std::max(std::min(x3, (float)width - 1), 0.f);
-            faceobjects[i].landmark[3].y = std::max(std::min(y3, (float)height - 1), 0.f);
-            faceobjects[i].landmark[4].x = std::max(std::min(x4, (float)width - 1), 0.f);
-            faceobjects[i].landmark[4].y = std::max(std::min(y4, (float)height - 1), 0.f);
+            for (int k = 0; k < 5; k++)
+            {
+                faceobjects[i].landmark[k].x = std::max(std::min(faceobjects[i].landmark[k].x, (float)width - 1), 0.f);
+                faceobjects[i].landmark[k].y = std::max(std::min(faceobjects[i].landmark[k].y, (float)height - 1), 0.f);
+            }
         }
     }
 
 
     /*关键点
      **/
-    if (faceobjects.size() > 0){
-        for(int i = 0; i < faceobjects.size(); i++){
-            return_d_m image_str = pre_process(rgb,192,faceobjects[i]);
-            cv::Mat clip_rgb = image_str.dst;
-
-            ncnn::Mat face_input = ncnn::Mat::from_pixels_resize(clip_rgb.data, ncnn::Mat::PIXEL_RGB, clip_rgb.cols, clip_rgb.rows, 192, 192);
-            const float face_mean_vals[3] = {0.f, 0.f,0.f};
-            const float face_norm_vals[3] = {1.f, 1.f,1.f};
-            face_input.substract_mean_normalize(face_mean_vals, face_norm_vals);
-            ncnn::Mat face_output;
-            ncnn::Extractor ex_face = landmarks.create_extractor();
-            ex_face.input("data", face_input); // 推理
-            ex_face.extract("fc1", face_output); //face_output.w = 212 face_output.h = 1. 将模型推理输出存储在ncnn::Mat对象
+    if (face_count > 0)
+    {
+        result.landmarks.resize(face_count * 106);
+
+        const float budget_ms = config.landmark_budget_ms;
+        if (budget_ms > 0.f)
+        {
+            schedule_landmarks(faceobjects, config.landmark_priority, ws);
+        }
+        else
+        {
+            ws.landmark_order.resize(face_count);
+            for (int i = 0; i < face_count; i++)
+                ws.landmark_order[i] = i;
+        }
+
+        const SCRFD& lmk = landmark_source();
+
+        const double t0 = ncnn::get_current_time();
+
+        for (int k = 0; k < face_count; k++)
+        {
+            const int i = ws.landmark_order[k];
+
+            if (budget_ms > 0.f && k > 0 && ncnn::get_current_time() - t0 + ws.landmark_face_ms > budget_ms)
+            {
+                // over budget, carry the previous points over or fall back to the 5 keypoints
+                const int match = ws.landmark_match[i];
+                cv::Point2f* points = result.face_landmarks(i);
+                if (match >= 0 && ws.prev_faceobjects[match].landmark_state != FaceObject::LANDMARK_FALLBACK)
+                {
+                    const FaceObject& prev = ws.prev_faceobjects[match];
+                    const FaceObject& obj = faceobjects[i];
+                    const float dx = (obj.rect.x + obj.rect.width * 0.5f) - (prev.rect.x + prev.rect.width * 0.5f);
+                    const float dy = (obj.rect.y + obj.rect.height * 0.5f) - (prev.rect.y + prev.rect.height * 0.5f);
+                    const cv::Point2f* prev_points = &ws.prev_landmarks[match * 106];
+                    for (int j = 0; j < 106; j++)
+                    {
+                        points[j].x = prev_points[j].x + dx;
+                        points[j].y = prev_points[j].y + dy;
+                    }
 
+                    faceobjects[i].landmark_state = FaceObject::LANDMARK_DEFERRED;
+                }
+                else
+                {
+                    std::fill(points, points + 106, cv::Point2f(0.f, 0.f));
 
-            cv::Mat cvMat(212, 1, CV_32FC1);
-            for(int i =0; i < face_output.w; i++){
-                cvMat.at<float>(i,0) = face_output[i];
+                    faceobjects[i].landmark_state = FaceObject::LANDMARK_FALLBACK;
+                }
+                continue;
             }
 
-            cv::Mat coord = post_progress(cvMat, image_str.matri);
-            NCNN_LOGE("result.rows= %d", coord.rows);
-            NCNN_LOGE("result.cols= %d", coord.cols);
+            SCRFD_TRACE_SCOPE("landmark");
+
+            const double t1 = ncnn::get_current_time();
+
+            double affine[6];
+            pre_process(rgb, rotate_type, 192, faceobjects[i], ws.face_crop, affine);
+
+            const cv::Mat& clip_rgb = ws.face_crop;
+            ncnn::Mat face_input = ncnn::Mat::from_pixels(clip_rgb.data, ncnn::Mat::PIXEL_RGB, clip_rgb.cols, clip_rgb.rows, &ctx.blob_allocator);
+
+            ncnn::Mat face_output;
+            ncnn::Extractor ex_face = lmk.landmarks.create_extractor();
+            ex_face.set_blob_allocator(&ctx.blob_allocator);
+            ex_face.set_workspace_allocator(&ctx.workspace_allocator);
+            if (ctx.landmark_threads > 0)
+                ex_face.set_num_threads(ctx.landmark_threads);
+            ex_face.input(lmk.blob_ids.landmark_input, face_input); // 推理
+            ex_face.extract(lmk.blob_ids.landmark_output, face_output); //face_output.w = 212 face_output.h = 1
+
+            post_progress(face_output, 192, affine, result.face_landmarks(i));
+
+            faceobjects[i].landmark_state = FaceObject::LANDMARK_FRESH;
+
+            // per-face cost estimate for the deadline check
+            const float face_ms = ncnn::get_current_time() - t1;
+            metrics_record(METRIC_LANDMARK, face_ms);
+            ws.landmark_face_ms = ws.landmark_face_ms > 0.f ? ws.landmark_face_ms * 0.8f + face_ms * 0.2f : face_ms;
+        }
+    }
+
+    if (config.landmark_budget_ms > 0.f)
+    {
+        ws.prev_faceobjects = faceobjects;
+        ws.prev_landmarks = result.landmarks;
+    }
+}
+
+int SCRFD::detect_batch(const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold, float nms_threshold)
+{
+    return detect_batch(default_context, rgbs, results, prob_threshold, nms_threshold);
+}
+
+int SCRFD::detect_batch(SCRFDContext& ctx, const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold, float nms_threshold) const
+{
+    SCRFD_TRACE_SCOPE("detect_batch");
+
+    DetectionWorkspace& ws = ctx.workspace;
+
+    const int count = (int)rgbs.size();
+    results.resize(count);
+
+    if (count == 0)
+        return 0;
 
-            facelandmarks.push_back(coord);
+    // unrelated images, set the deferred landmark state of detect() on ctx aside and give it back after
+    std::vector<FaceObject> prev_faceobjects;
+    std::vector<cv::Point2f> prev_landmarks;
+    ws.prev_faceobjects.swap(prev_faceobjects);
+    ws.prev_landmarks.swap(prev_landmarks);
 
+    // inclusion crops are per frame, run them one by one
+    if (!config.include_regions.empty())
+    {
+        for (int i = 0; i < count; i++)
+        {
+            ws.prev_faceobjects.clear();
+            ws.prev_landmarks.clear();
+
+            detect(ctx, rgbs[i], results[i], prob_threshold, nms_threshold);
         }
     }
-//    ncnn::Mat face_input = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, width, height, 192, 192);
-//    const float face_mean_vals[3] = {0.f, 0.f,0.f};
-//    const float face_norm_vals[3] = {1.f, 1.f,1.f};
-//    face_input.substract_mean_normalize(face_mean_vals, face_norm_vals);
-//    ncnn::Mat face_output;
-//    ncnn::Extractor ex_face = landmarks.create_extractor();
-//    ex_face.input("data", face_input);
-//    ex_face.extract("fc1", face_output);
+    else
+    {
+        detect_mosaic(ctx, rgbs, results, prob_threshold, nms_threshold);
+    }
+
+    ws.prev_faceobjects.swap(prev_faceobjects);
+    ws.prev_landmarks.swap(prev_landmarks);
 
     return 0;
 }
 
-int SCRFD::draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects, const std::vector<cv::Mat>& facelandmarks)
+void SCRFD::detect_mosaic(SCRFDContext& ctx, const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold, float nms_threshold) const
 {
-    for (size_t i = 0; i < faceobjects.size(); i++)
+    DetectionWorkspace& ws = ctx.workspace;
+
+    const int count = (int)rgbs.size();
+
+    const int target_size = ctx.target_size > 0 ? ctx.target_size : config.target_size;
+
+    // square grid of target_size cells, every cell surrounded by a pad margin
+    // one stride 32 cell keeps the smaller heads from seeing the neighbour tile
+    const int margin = 32;
+    const int cell = target_size + margin;
+    const int cols = (int)ceil(sqrt((float)count));
+    const int rows = (count + cols - 1) / cols;
+    const int canvas_w = (cols * cell + margin + 31) / 32 * 32;
+    const int canvas_h = (rows * cell + margin + 31) / 32 * 32;
+
+    // heads needed by any tile
+    float min_size = FLT_MAX;
+    float max_size = 0.f;
+
+    ws.tiles.resize(count);
+    ws.tile_scales.resize(count);
+
     {
-        const FaceObject& obj = faceobjects[i];
+        SCRFD_TRACE_SCOPE("preprocess");
+
+        ws.in_pad.create(canvas_w, canvas_h, 3, 4u, &ctx.blob_allocator);
+        ws.in_pad.fill((0.f - scrfd_mean_val) * scrfd_norm_val);
+
+        for (int i = 0; i < count; i++)
+        {
+            const cv::Mat& rgb = rgbs[i];
+
+            // same scale as detect()
+            int w = rgb.cols;
+            int h = rgb.rows;
+            float scale = 1.f;
+            if (w > h)
+            {
+                scale = (float)target_size / w;
+                w = target_size;
+                h = h * scale;
+            }
+            else
+            {
+                scale = (float)target_size / h;
+                h = target_size;
+                w = w * scale;
+            }
+
+            const cv::Rect tile(margin + (i % cols) * cell, margin + (i / cols) * cell, w, h);
+
+            ws.resized.resize(w * h * 3);
+            ncnn::resize_bilinear_c3(rgb.data, rgb.cols, rgb.rows, (int)rgb.step, ws.resized.data(), w, h, w * 3);
+
+            normalize_into(ws.resized.data(), w, h, ws.in_pad, tile.x, tile.y);
+
+            ws.tiles[i] = tile;
+            ws.tile_scales[i] = scale;
+
+            min_size = std::min(min_size, config.min_face_size > 0 ? config.min_face_size * scale : 0.f);
+            max_size = std::max(max_size, config.max_face_size > 0 ? config.max_face_size * scale : FLT_MAX);
+        }
+    }
+
+    ws.proposals.clear();
+
+    const double decode_ms = extract_proposals(ctx, min_size, max_size, prob_threshold);
+
+    const double t2 = ncnn::get_current_time();
+
+    // give every candidate to the tile holding its center, those centered in the margins are dropped
+    // then filter by the tile face size range and map into its own image coordinates
+    std::vector<FaceObject>& mosaic_proposals = ws.mosaic_proposals;
+    std::vector<int>& mosaic_owner = ws.mosaic_owner;
+    mosaic_proposals.clear();
+    mosaic_owner.clear();
+
+    for (size_t j = 0; j < ws.proposals.size(); j++)
+    {
+        FaceObject obj = ws.proposals[j];
+
+        const float cx = obj.rect.x + obj.rect.width * 0.5f;
+        const float cy = obj.rect.y + obj.rect.height * 0.5f;
+
+        const int col = (int)((cx - margin) / cell);
+        const int row = (int)((cy - margin) / cell);
+        const int i = row * cols + col;
+        if (cx < margin || cy < margin || col >= cols || i >= count)
+            continue;
+
+        const cv::Rect& tile = ws.tiles[i];
+        if (cx >= tile.x + tile.width || cy >= tile.y + tile.height)
+            continue;
+
+        const float scale = ws.tile_scales[i];
+
+        const float size = std::max(obj.rect.width, obj.rect.height);
+        if ((config.min_face_size > 0 && size < config.min_face_size * scale) || (config.max_face_size > 0 && size > config.max_face_size * scale))
+            continue;
+
+        obj.rect.x = (obj.rect.x - tile.x) / scale;
+        obj.rect.y = (obj.rect.y - tile.y) / scale;
+        obj.rect.width = obj.rect.width / scale;
+        obj.rect.height = obj.rect.height / scale;
+
+        if (has_kps)
+        {
+            for (int k = 0; k < 5; k++)
+            {
+                obj.landmark[k].x = (obj.landmark[k].x - tile.x) / scale;
+                obj.landmark[k].y = (obj.landmark[k].y - tile.y) / scale;
+            }
+        }
+
+        mosaic_proposals.push_back(obj);
+        mosaic_owner.push_back(i);
+    }
+
+    metrics_record(METRIC_DECODE, decode_ms + ncnn::get_current_time() - t2);
+
+    // split back per image, exclusion, nms, clip and landmarks as in detect()
+    for (int i = 0; i < count; i++)
+    {
+        ws.proposals.clear();
+        for (size_t j = 0; j < mosaic_proposals.size(); j++)
+        {
+            if (mosaic_owner[j] == i)
+                ws.proposals.push_back(mosaic_proposals[j]);
+        }
+
+        // no previous frame to carry deferred landmarks from
+        ws.prev_faceobjects.clear();
+        ws.prev_landmarks.clear();
+
+        finish_detect(ctx, rgbs[i], 1, results[i], nms_threshold);
+    }
+}
+
+int SCRFD::draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects, const std::vector<cv::Mat>& facelandmarks) const
+{
+    FrameResult result;
+    result.from_mats(faceobjects, facelandmarks);
+
+    return draw(rgb, result);
+}
+
+int SCRFD::draw(cv::Mat& rgb, const FrameResult& result) const
+{
+    for (int i = 0; i < result.face_count(); i++)
+    {
+        const FaceObject& obj = result.faceobjects[i];
 
 //         fprintf(stderr, "%.5f at %.2f %.2f %.2f x %.2f\n", obj.prob,
 //                 obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
 
         cv::rectangle(rgb, obj.rect, cv::Scalar(0, 255, 0));
 
-        for(int j =0; j < facelandmarks[i].rows; j++){ //绘制关键点
-            float x = facelandmarks[i].at<float>(j, 0);
-            float y = facelandmarks[i].at<float>(j, 1);
-            cv::circle(rgb,cv::Point2f(x, y),2, cv::Scalar(255, 255, 0), -1);
+        if (result.has_landmarks() && obj.landmark_state != FaceObject::LANDMARK_FALLBACK)
+        {
+            const cv::Point2f* points = result.face_landmarks(i);
+            for (int j = 0; j < 106; j++) //绘制关键点
+            {
+                cv::circle(rgb, points[j], 2, cv::Scalar(255, 255, 0), -1);
+            }
         }
 
         if (has_kps)
@@ -612,3 +1545,64 @@ int SCRFD::draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects, const
 
     return 0;
 }
+
+int SCRFD::draw_overlay(cv::Mat& image, const FrameResult& result, int rotate_type) const
+{
+    const OverlayImage im = overlay_image(image);
+
+    // layout happens on the upright frame
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type_inverse(rotate_type), im.w, im.h, &upright_w, &upright_h);
+
+    static const unsigned char box_color[4] = {0, 255, 0, 255};
+    static const unsigned char point_color[4] = {255, 255, 0, 255};
+    static const unsigned char label_color[4] = {255, 255, 255, 255};
+    static const unsigned char text_color[4] = {0, 0, 0, 255};
+
+    for (int i = 0; i < result.face_count(); i++)
+    {
+        const FaceObject& obj = result.faceobjects[i];
+
+        const cv::Rect_<float> box((int)obj.rect.x, (int)obj.rect.y, (int)obj.rect.width, (int)obj.rect.height);
+        const cv::Rect_<float> rbox = rotate_rect(rotate_type, upright_w, upright_h, box);
+        overlay_rect(im, (int)rbox.x, (int)rbox.y, (int)rbox.width, (int)rbox.height, box_color);
+
+        if (result.has_landmarks() && obj.landmark_state != FaceObject::LANDMARK_FALLBACK)
+        {
+            cv::Point2f points[106];
+            memcpy(points, result.face_landmarks(i), sizeof(points));
+            rotate_points(rotate_type, upright_w, upright_h, points, 106);
+            overlay_points(im, points, 106, point_color);
+        }
+
+        if (has_kps)
+        {
+            cv::Point2f points[5];
+            memcpy(points, obj.landmark, sizeof(points));
+            rotate_points(rotate_type, upright_w, upright_h, points, 5);
+            overlay_points(im, points, 5, point_color);
+        }
+
+        char text[256];
+        sprintf(text, "%.1f%%", obj.prob * 100);
+
+        int label_w = 0;
+        int label_h = 0;
+        overlay_text_size(text, 2, &label_w, &label_h);
+
+        // 2 pixel border around the glyphs
+        int x = obj.rect.x;
+        int y = obj.rect.y - label_h - 4;
+        if (y < 0)
+            y = 0;
+        if (x + label_w + 4 > upright_w)
+            x = upright_w - label_w - 4;
+
+        const cv::Rect_<float> label = rotate_rect(rotate_type, upright_w, upright_h, cv::Rect_<float>(x, y, label_w + 4, label_h + 4));
+        overlay_fill_rect(im, (int)label.x, (int)label.y, (int)label.width, (int)label.height, label_color);
+        overlay_text(im, x + 2, y + 2, text, 2, text_color, rotate_type);
+    }
+
+    return 0;
+}
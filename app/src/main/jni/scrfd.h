@@ -24,29 +24,306 @@ struct FaceObject
     cv::Rect_<float> rect; //预测框空间参数
     cv::Point2f landmark[5]; //关键点
     float prob; //置信度
+
+    // where the 106 points of this face came from when the landmark budget is on
+    enum
+    {
+        LANDMARK_FRESH      = 0, // computed this frame
+        LANDMARK_DEFERRED   = 1, // missed the budget, previous frame points moved with the box, first in line next frame
+        LANDMARK_FALLBACK   = 2  // missed the budget with nothing to carry over, 106 points are zero, use landmark[5]
+    };
+    int landmark_state;
+};
+
+// detection results of one frame, all faces in contiguous arrays
+// clear() keeps the capacity, so reusing one FrameResult across frames does no heap allocation once warmed up
+struct FrameResult
+{
+    std::vector<FaceObject> faceobjects;
+    // 106 points per face in face order, empty when landmarks were not computed
+    std::vector<cv::Point2f> landmarks;
+
+    struct FaceView
+    {
+        const FaceObject* object;
+        const cv::Point2f* landmarks; // 106 points or null
+    };
+
+    void clear() { faceobjects.clear(); landmarks.clear(); }
+    int face_count() const { return (int)faceobjects.size(); }
+    bool has_landmarks() const { return !landmarks.empty(); }
+
+    FaceView face(int i) const;
+    const cv::Point2f* face_landmarks(int i) const { return &landmarks[i * 106]; }
+    cv::Point2f* face_landmarks(int i) { return &landmarks[i * 106]; }
+
+    // compatibility with the vector<cv::Mat> api, one 106x2 CV_32F mat per face
+    void to_mats(std::vector<cv::Mat>& facelandmarks) const;
+    void from_mats(const std::vector<FaceObject>& faceobjects, const std::vector<cv::Mat>& facelandmarks);
+};
+
+// per-net ncnn::Option overrides, defaults follow ncnn::Option
+struct SCRFDNetConfig
+{
+    SCRFDNetConfig();
+
+    bool use_fp16_packed;
+    bool use_fp16_storage;
+    bool use_fp16_arithmetic;
+    bool use_packing_layout;
+    bool use_winograd_convolution;
+    bool use_sgemm_convolution;
+    bool lightmode;
+
+    // 0 = ncnn::get_big_cpu_count()
+    int num_threads;
+
+    // cores the net runs on, 0 = all 1 = little 2 = big, see cpuaffinity.h
+    // detect() runs both nets on the thread it is called from, bound with SCRFD::bind_thread() to the detector cores
+    // so landmark.powersave only matters to benchmark_landmark(), autotune keeps it equal to detector.powersave
+    int powersave;
+
+    void apply(ncnn::Option& opt) const;
+
+    // bit flags for passing through jni, see SCRFDNcnn.java
+    enum
+    {
+        FP16_PACKED         = 1 << 0,
+        FP16_STORAGE        = 1 << 1,
+        FP16_ARITHMETIC     = 1 << 2,
+        PACKING_LAYOUT      = 1 << 3,
+        WINOGRAD            = 1 << 4,
+        SGEMM               = 1 << 5,
+        LIGHTMODE           = 1 << 6,
+        ALL_FLAGS           = (1 << 7) - 1
+    };
+
+    int to_flags() const;
+    void from_flags(int flags);
+};
+
+struct SCRFDConfig
+{
+    SCRFDConfig();
+
+    SCRFDNetConfig detector; //检测模型设置
+    SCRFDNetConfig landmark; //关键点模型设置
+
+    // detector input long side before padding to multiple of 32
+    int target_size;
+
+    // time for all 2d106det runs of one frame, 0 = no limit
+    // the first face in priority order is always run
+    float landmark_budget_ms;
+
+    // face size range of interest in input image pixels, long side of the box, 0 = no limit
+    // stride heads that cannot produce faces in range are not extracted at all
+    int min_face_size;
+    int max_face_size;
+
+    // fixed camera regions in input image pixels
+    // non-empty include_regions runs the detector only on their crops, overlapping ones merged
+    // faces centered in exclude_regions are dropped before nms and landmarks
+    std::vector<cv::Rect> include_regions;
+    std::vector<cv::Rect> exclude_regions;
+
+    // which faces get landmarks first when over budget
+    enum
+    {
+        LANDMARK_BY_AREA    = 0,
+        LANDMARK_BY_PROB    = 1
+    };
+    int landmark_priority;
+};
+
+// blob indices of the loaded nets, resolved once at load so extraction skips the name lookup
+struct SCRFDBlobIds
+{
+    int input;
+    int score[3];
+    int bbox[3];
+    // -1 for models without keypoints
+    int kps[3];
+    int landmark_input;
+    int landmark_output;
+};
+
+// per-frame temporaries of SCRFD::detect, kept across frames and sized to the high-water mark
+struct DetectionWorkspace
+{
+    // resized rgb pixels and the padded, normalized detector input
+    // sensor_resized holds them before the rotation upright when detecting on a sensor orientation frame
+    std::vector<unsigned char> resized;
+    std::vector<unsigned char> sensor_resized;
+    ncnn::Mat in_pad;
+
+    // stride 8 16 32 head outputs
+    ncnn::Mat score_blobs[3];
+    ncnn::Mat bbox_blobs[3];
+    ncnn::Mat kps_blobs[3];
+
+    // merged inclusion crops of this frame
+    std::vector<cv::Rect> regions;
+
+    // candidates of all strides and nms scratch
+    std::vector<FaceObject> proposals;
+    std::vector<int> picked;
+    std::vector<float> areas;
+
+    // detect_batch mosaic layout, tile of each image in the canvas and its scale
+    std::vector<cv::Rect> tiles;
+    std::vector<float> tile_scales;
+
+    // detect_batch candidates in image coordinates and the image each belongs to
+    std::vector<FaceObject> mosaic_proposals;
+    std::vector<int> mosaic_owner;
+
+    // landmark net input crop, reused across faces
+    cv::Mat face_crop;
+
+    // landmark scheduling, faces in priority order and their match in the previous frame
+    std::vector<int> landmark_order;
+    std::vector<int> landmark_match;
+    std::vector<float> landmark_keys;
+    float landmark_face_ms;
+
+    // previous frame faces, for carrying deferred landmarks over
+    std::vector<FaceObject> prev_faceobjects;
+    std::vector<cv::Point2f> prev_landmarks;
+
+    DetectionWorkspace() : landmark_face_ms(0.f) {}
+};
+
+// per-stream state for calling SCRFD::detect concurrently from many threads
+// the nets and their weights are loaded once in SCRFD and shared by all contexts
+class SCRFDContext
+{
+public:
+    SCRFDContext();
+
+    // 0 = use the setting from SCRFDConfig
+    // per call settings, change them here between detect() calls rather than through the SCRFD setters
+    int detector_threads;
+    int landmark_threads;
+    int target_size;
+
+    ncnn::UnlockedPoolAllocator blob_allocator;
+    ncnn::UnlockedPoolAllocator workspace_allocator;
+
+    DetectionWorkspace workspace;
+
+private:
+    SCRFDContext(const SCRFDContext&);
+    SCRFDContext& operator=(const SCRFDContext&);
 };
 
 class SCRFD
 {
 public:
-    int load(const char* modeltype, bool use_gpu = false);
+    SCRFD() : has_kps(false), landmark_owner(0) {}
+
+    // run the 2d106det net of owner instead of loading one, call before load()
+    // eg. detectors of several sizes sharing one landmark net, owner must stay loaded while this detects
+    void share_landmark(const SCRFD* owner) { landmark_owner = owner; }
+    bool shares_landmark() const { return landmark_owner != 0; }
+
+    int load(const char* modeltype, bool use_gpu = false, const SCRFDConfig& config = SCRFDConfig());
+
+#if __ANDROID_API__ >= 9
+    int load(AAssetManager* mgr, const char* modeltype, bool use_gpu = false, const SCRFDConfig& config = SCRFDConfig()); //加载模型
+#endif // __ANDROID_API__ >= 9
+
+    int detect(const cv::Mat& rgb, FrameResult& result, float prob_threshold = 0.5f, float nms_threshold = 0.45f); //模型推理
+
+    // re-entrant, safe to call from many threads at once with one context per thread
+    int detect(SCRFDContext& ctx, const cv::Mat& rgb, FrameResult& result, float prob_threshold = 0.5f, float nms_threshold = 0.45f) const;
+
+    // rgb in sensor orientation, rotate_type as in ncnn::kanna_rotate_c3 turns it upright
+    // only the small detector input and the landmark crops are sampled upright, the frame itself is never rotated
+    // results, face size range and regions are all in upright coordinates
+    int detect(const cv::Mat& rgb, int rotate_type, FrameResult& result, float prob_threshold = 0.5f, float nms_threshold = 0.45f);
+    int detect(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, FrameResult& result, float prob_threshold = 0.5f, float nms_threshold = 0.45f) const;
+
+    // many images through one detector inference, results[i] for rgbs[i]
+    // every image is scaled as in detect() and packed into a grid mosaic with pad margins between tiles,
+    // candidates are split back by tile before nms, landmarks then run per face as usual
+    // worth it when target_size is small and per-inference overhead dominates, eg. offline sets or many streams
+    // deferred landmarks are not carried across calls, each image is treated as unrelated
+    int detect_batch(const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold = 0.5f, float nms_threshold = 0.45f);
+    int detect_batch(SCRFDContext& ctx, const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold = 0.5f, float nms_threshold = 0.45f) const;
+
+    int draw(cv::Mat& rgb, const FrameResult& result) const; //根据模型输出绘图
 
-    int load(AAssetManager* mgr, const char* modeltype, bool use_gpu = false); //加载模型
+    // same overlay as draw() with the row-fill renderer in overlay.h, rgb or rgba
+    // image may be the upright frame turned by rotate_type, eg. the window orientation, result stays upright
+    // boxes and points are mapped into image and labels still read upright to the viewer
+    int draw_overlay(cv::Mat& image, const FrameResult& result, int rotate_type = 1) const;
 
-    int detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std::vector<cv::Mat>& facelandmarks,float prob_threshold = 0.5f, float nms_threshold = 0.45f); //模型推理
+    // vector<cv::Mat> landmark api, adapters over the FrameResult ones
+    int detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std::vector<cv::Mat>& facelandmarks,float prob_threshold = 0.5f, float nms_threshold = 0.45f);
+    int detect(SCRFDContext& ctx, const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, std::vector<cv::Mat>& facelandmarks, float prob_threshold = 0.5f, float nms_threshold = 0.45f) const;
+    int draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects,const std::vector<cv::Mat>& facelandmarks) const;
 
-    int draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects,const std::vector<cv::Mat>& facelandmarks); //根据模型输出绘图
+    // change thread count and core set of the loaded nets, see autotune.h
+    // a shared landmark net keeps the thread count of its owner
+    void set_threads(int det_threads, int det_powersave, int lmk_threads, int lmk_powersave);
+
+    // pin the calling thread and its ncnn openmp team to the detector cores
+    // detect() never changes thread affinity, call this once on each thread that runs it and again after set_threads()
+    // a no-op when the thread is already bound to the same cores
+    int bind_thread() const;
+
+    // the setters below and set_threads() write the config every detect() reads without locking
+    // not safe while detect() runs on any context, call them between frames or under the caller's own lock
+    // per call sizes belong in SCRFDContext::target_size
+    void set_target_size(int target_size) { config.target_size = target_size; }
+
+    void set_face_size_range(int min_face_size, int max_face_size) { config.min_face_size = min_face_size; config.max_face_size = max_face_size; }
+
+    void set_regions(const std::vector<cv::Rect>& include_regions, const std::vector<cv::Rect>& exclude_regions) { config.include_regions = include_regions; config.exclude_regions = exclude_regions; }
+
+    void set_landmark_budget(float budget_ms, int priority) { config.landmark_budget_ms = budget_ms; config.landmark_priority = priority; }
+
+    const SCRFDConfig& get_config() const { return config; }
+
+    // average ms of one inference on a synthetic input with the given thread setting
+    double benchmark_detector(int num_threads, int powersave, int loops);
+    double benchmark_landmark(int num_threads, int powersave, int loops);
+
+private:
+    friend class TiledDetector;
+
+    // run the detector on rgb resized and rotated upright to w x h, append proposals offset into upright frame coordinates
+    void detect_region(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, int w, int h, float scale, const cv::Point& offset, float prob_threshold) const;
+
+    // run the detector on workspace in_pad, append proposals in net input coordinates, returns decode ms
+    double extract_proposals(SCRFDContext& ctx, float min_size, float max_size, float prob_threshold) const;
+
+    // the detect_batch() mosaic path, one detector inference for all of rgbs
+    void detect_mosaic(SCRFDContext& ctx, const std::vector<cv::Mat>& rgbs, std::vector<FrameResult>& results, float prob_threshold, float nms_threshold) const;
+
+    // exclusion, nms, clip and landmarks on workspace proposals in upright coordinates of rgb rotated by rotate_type
+    void finish_detect(SCRFDContext& ctx, const cv::Mat& rgb, int rotate_type, FrameResult& result, float nms_threshold) const;
+
+    // the instance holding the landmark net and its blob ids
+    const SCRFD& landmark_source() const { return landmark_owner ? *landmark_owner : *this; }
 
 private:
     ncnn::Net scrfd; //声明检测模型
     bool has_kps;
     ncnn::Net landmarks; //声明关键点模型
-};
+    SCRFDConfig config;
 
-struct  return_d_m //关键点前处理
-{
-    cv::Mat dst;
-    cv::Mat matri;
+    // null = landmarks is our own, see share_landmark()
+    const SCRFD* landmark_owner;
+
+    // stride 8 16 32 anchors, fixed per model
+    ncnn::Mat anchors[3];
+
+    SCRFDBlobIds blob_ids;
+
+    // used by the single-stream detect()
+    SCRFDContext default_context;
 };
 
 #endif // SCRFD_H
@@ -0,0 +1,31 @@
+#ifndef SCRFDKERNELS_H
+#define SCRFDKERNELS_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <net.h>
+
+#include "scrfd.h"
+
+// building blocks of SCRFD::detect, exposed for tools/benchkernels
+
+void qsort_descent_inplace(std::vector<FaceObject>& faceobjects);
+
+// areas is scratch for the picked boxes, kept by the caller to avoid reallocation
+void nms_sorted_bboxes(const std::vector<FaceObject>& faceobjects, std::vector<int>& picked, std::vector<float>& areas, float nms_threshold);
+
+ncnn::Mat generate_anchors(int base_size, const ncnn::Mat& ratios, const ncnn::Mat& scales);
+
+// append candidates above prob_threshold of one stride head, kps_blob empty for models without keypoints
+void generate_proposals(const ncnn::Mat& anchors, int feat_stride, const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, const ncnn::Mat& kps_blob, float prob_threshold, std::vector<FaceObject>& faceobjects);
+
+// landmark net crop and back projection
+void pre_process(const cv::Mat& src, int input_size, const FaceObject& det, cv::Mat& dst, double affine[6]);
+
+// same with src in sensor orientation and rotate_type turning it upright, det and affine stay upright
+void pre_process(const cv::Mat& src, int rotate_type, int input_size, const FaceObject& det, cv::Mat& dst, double affine[6]);
+void post_progress(const float* output, int input_size, const double affine[6], cv::Point2f* coord);
+
+#endif // SCRFDKERNELS_H
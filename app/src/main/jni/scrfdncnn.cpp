@@ -25,8 +25,18 @@
 
 #include <platform.h>
 #include <benchmark.h>
+#include <cpu.h>
+#include <mat.h>
 
 #include "scrfd.h"
+#include "autotune.h"
+#include "latencycontroller.h"
+#include "metrics.h"
+#include "motiongate.h"
+#include "rotation.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "facerecord.h"
 
 #include "ndkcamera.h"
 
@@ -37,26 +47,56 @@
 #include <arm_neon.h>
 #endif // __ARM_NEON
 
-static int draw_unsupported(cv::Mat& rgb)
+// black text on white at x y of the upright frame, rgb is that frame turned by rotate_type
+// drawn upright into a patch that is turned the same way, so it reads upright to the viewer
+static void draw_label(cv::Mat& rgb, int rotate_type, const char* text, double font_scale, int x, int y)
+{
+    int baseLine = 0;
+    cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, font_scale, 1, &baseLine);
+
+    cv::Mat label(label_size.height + baseLine, label_size.width, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    cv::putText(label, text, cv::Point(0, label_size.height),
+                cv::FONT_HERSHEY_SIMPLEX, font_scale, cv::Scalar(0, 0, 0));
+
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type_inverse(rotate_type), rgb.cols, rgb.rows, &upright_w, &upright_h);
+
+    const cv::Rect_<float> box = rotate_rect(rotate_type, upright_w, upright_h, cv::Rect_<float>(x, y, label.cols, label.rows));
+    const cv::Rect label_rect((int)box.x, (int)box.y, (int)box.width, (int)box.height);
+
+    cv::Mat label_render(label_rect.height, label_rect.width, CV_8UC3);
+    ncnn::kanna_rotate_c3(label.data, label.cols, label.rows, label_render.data, label_render.cols, label_render.rows, rotate_type);
+
+    const cv::Rect roi = label_rect & cv::Rect(0, 0, rgb.cols, rgb.rows);
+    if (roi.width <= 0 || roi.height <= 0)
+        return;
+
+    cv::Mat dst = rgb(roi);
+    label_render(cv::Rect(roi.x - label_rect.x, roi.y - label_rect.y, roi.width, roi.height)).copyTo(dst);
+}
+
+static int draw_unsupported(cv::Mat& rgb, int rotate_type)
 {
     const char text[] = "unsupported";
 
     int baseLine = 0;
     cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 1.0, 1, &baseLine);
 
-    int y = (rgb.rows - label_size.height) / 2;
-    int x = (rgb.cols - label_size.width) / 2;
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type_inverse(rotate_type), rgb.cols, rgb.rows, &upright_w, &upright_h);
 
-    cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)),
-                    cv::Scalar(255, 255, 255), -1);
+    int y = (upright_h - label_size.height) / 2;
+    int x = (upright_w - label_size.width) / 2;
 
-    cv::putText(rgb, text, cv::Point(x, y + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 0));
+    draw_label(rgb, rotate_type, text, 1.0, x, y);
 
     return 0;
 }
 
-static int draw_fps(cv::Mat& rgb)
+static int draw_fps(cv::Mat& rgb, int rotate_type)
 {
     // resolve moving average
     float avg_fps = 0.f;
@@ -98,52 +138,310 @@ static int draw_fps(cv::Mat& rgb)
     int baseLine = 0;
     cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
 
-    int y = 0;
-    int x = rgb.cols - label_size.width;
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type_inverse(rotate_type), rgb.cols, rgb.rows, &upright_w, &upright_h);
 
-    cv::rectangle(rgb, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)),
-                    cv::Scalar(255, 255, 255), -1);
+    int y = 0;
+    int x = upright_w - label_size.width;
 
-    cv::putText(rgb, text, cv::Point(x, y + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
+    draw_label(rgb, rotate_type, text, 0.5, x, y);
 
     return 0;
 }
 
+static const char* modeltypes[] =
+{
+    "500m",
+    "500m_kps",
+    "1g",
+    "2.5g",
+    "2.5g_kps",
+    "10g",
+    "10g_kps",
+    "34g"
+};
+
 static SCRFD* g_scrfd = 0;
 static ncnn::Mutex lock;
 
+// preloaded detectors indexed by modelid, switched by the latency controller
+// the first level loaded owns the one landmark net the others share
+static SCRFD* g_level_scrfd[8] = {0};
+static LatencyController* g_controller = 0;
+
+// per-frame results journal, see startRecording
+static FaceRecordWriter g_recorder;
+static uint64_t g_frame_id = 0;
+
+// net options of the last loadModel or loadModelWithOptions, the latency levels load with them too
+static SCRFDConfig g_model_config;
+
+// autotune results are cached here when set, see setTuneCachePath
+static std::string g_tune_cache_path;
+
+// manual thread setting from setThreadConfig, overrides autotune
+static bool g_manual_threads = false;
+static SCRFDConfig g_manual_threads_config;
+
+// face size range from setFaceSizeRange, applied to every loaded net
+static int g_min_face_size = 0;
+static int g_max_face_size = 0;
+
+// inclusion and exclusion regions from setRegions, applied to every loaded net
+static std::vector<cv::Rect> g_include_regions;
+static std::vector<cv::Rect> g_exclude_regions;
+
+// per-frame landmark budget from setLandmarkBudget, applied to every loaded net
+static float g_landmark_budget_ms = 0.f;
+static int g_landmark_priority = SCRFDConfig::LANDMARK_BY_AREA;
+
+// skip inference on unchanged frames, see setMotionGate
+static MotionGate g_motion_gate;
+static bool g_motion_skip = false;
+
+// whether scrfd is still loaded, models may be swapped between detect and draw of one frame
+static bool scrfd_loaded(const SCRFD* scrfd)
+{
+    if (!scrfd)
+        return false;
+
+    if (scrfd == g_scrfd)
+        return true;
+
+    for (int i = 0; i < 8; i++)
+    {
+        if (scrfd == g_level_scrfd[i])
+            return true;
+    }
+
+    return false;
+}
+
 class MyNdkCamera : public NdkCameraWindow
 {
 public:
-    virtual void on_image_render(cv::Mat& rgb) const;
+    MyNdkCamera() : frame_scrfd(0), inference_thread(1) {}
+
+    virtual void on_image_luma(const unsigned char* y, int width, int height, int stride, int rotate_type) const;
+
+    virtual void on_image_sensor(const cv::Mat& rgb, int rotate_type) const;
+
+    virtual void on_image_render(cv::Mat& rgb, int render_rotate_type) const;
+
+private:
+    // reused every frame, result is in upright coordinates
+    mutable FrameResult result;
+    mutable std::vector<cv::Rect> face_regions;
+
+    // the detector that produced result, drawn with in on_image_render
+    mutable const SCRFD* frame_scrfd;
+
+    // detect runs here bound to the detector cores, the camera thread keeps its own
+    mutable WorkStealingPool inference_thread;
+
+    // the latency level target size goes in per frame, the detectors are never reconfigured while running
+    mutable SCRFDContext ctx;
 };
 
-void MyNdkCamera::on_image_render(cv::Mat& rgb) const
+void MyNdkCamera::on_image_luma(const unsigned char* y, int width, int height, int stride, int rotate_type) const
+{
+    ncnn::MutexLockGuard g(lock);
+
+    // last faces back into sensor orientation
+    int upright_w = 0;
+    int upright_h = 0;
+    rotate_type_size(rotate_type, width, height, &upright_w, &upright_h);
+
+    const int sensor_rotate_type = rotate_type_inverse(rotate_type);
+
+    face_regions.resize(result.face_count());
+    for (int i = 0; i < result.face_count(); i++)
+    {
+        face_regions[i] = rotate_rect(sensor_rotate_type, upright_w, upright_h, result.faceobjects[i].rect);
+    }
+
+    g_motion_skip = g_motion_gate.check(y, width, height, stride, face_regions);
+}
+
+void MyNdkCamera::on_image_sensor(const cv::Mat& rgb, int rotate_type) const
 {
     // scrfd
+    ncnn::MutexLockGuard g(lock);
+
+    SCRFD* scrfd = g_scrfd;
+    ctx.target_size = 0;
+    if (g_controller)
+    {
+        const LatencyLevel& level = g_controller->current_level();
+        scrfd = g_level_scrfd[level.modelid];
+        ctx.target_size = level.target_size;
+    }
+
+    frame_scrfd = scrfd;
+
+    if (!scrfd)
+        return;
+
+    double t0 = ncnn::get_current_time();
+
+    if (g_motion_skip)
+    {
+        // unchanged scene, keep last frame faces
+        metrics_add(METRIC_SKIPS);
+    }
+    else
+    {
+        inference_thread.submit([&](int) {
+            scrfd->bind_thread();
+            scrfd->detect(ctx, rgb, rotate_type, result);
+        });
+        inference_thread.wait();
+
+        g_motion_gate.accept();
+
+        if (g_controller)
+            g_controller->update(ncnn::get_current_time() - t0);
+    }
+
+    if (g_recorder.is_open())
+        g_recorder.append(g_frame_id, (int64_t)(t0 * 1000), result);
+}
+
+void MyNdkCamera::on_image_render(cv::Mat& rgb, int render_rotate_type) const
+{
     {
         ncnn::MutexLockGuard g(lock);
 
-        if (g_scrfd)
+        if (scrfd_loaded(frame_scrfd))
         {
-            std::vector<FaceObject> faceobjects;
-            std::vector<cv::Mat> facelandmarks;
-
-            g_scrfd->detect(rgb, faceobjects,facelandmarks);
-            g_scrfd->draw(rgb, faceobjects, facelandmarks);
+            MetricTimer timer(METRIC_DRAW);
+            SCRFD_TRACE_SCOPE("draw");
+            frame_scrfd->draw_overlay(rgb, result, render_rotate_type);
         }
         else
         {
-            draw_unsupported(rgb);
+            draw_unsupported(rgb, render_rotate_type);
         }
+
+        g_frame_id++;
     }
 
-    draw_fps(rgb);
+    draw_fps(rgb, render_rotate_type);
 }
 
 static MyNdkCamera* g_camera = 0;
 
+// load modeltype into scrfd and apply manual or autotuned thread settings
+static void load_scrfd(SCRFD* scrfd, AAssetManager* mgr, const char* modeltype, bool use_gpu, const SCRFDConfig& config)
+{
+    scrfd->load(mgr, modeltype, use_gpu, config);
+
+    scrfd->set_face_size_range(g_min_face_size, g_max_face_size);
+    scrfd->set_regions(g_include_regions, g_exclude_regions);
+    scrfd->set_landmark_budget(g_landmark_budget_ms, g_landmark_priority);
+
+    if (g_manual_threads)
+    {
+        const SCRFDConfig& t = g_manual_threads_config;
+        scrfd->set_threads(t.detector.num_threads, t.detector.powersave, t.landmark.num_threads, t.landmark.powersave);
+    }
+    else if (!g_tune_cache_path.empty())
+    {
+        // a detector sharing its landmark net caches only detector settings, keep those apart
+        char key[128];
+        sprintf(key, "%s_%s_%d%s", modeltype, use_gpu ? "gpu" : "cpu", ncnn::get_cpu_count(), scrfd->shares_landmark() ? "_det" : "");
+
+        SCRFDConfig tuned = scrfd->get_config();
+        if (load_tune_cache(g_tune_cache_path.c_str(), key, tuned) == 0)
+        {
+            scrfd->set_threads(tuned.detector.num_threads, tuned.detector.powersave, tuned.landmark.num_threads, tuned.landmark.powersave);
+        }
+        else
+        {
+            scrfd_autotune(*scrfd, tuned);
+            save_tune_cache(g_tune_cache_path.c_str(), key, tuned);
+        }
+
+        __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "threads %s det %d/%d lmk %d/%d", key, tuned.detector.num_threads, tuned.detector.powersave, tuned.landmark.num_threads, tuned.landmark.powersave);
+    }
+}
+
+// x y w h quads
+static bool get_regions(JNIEnv* env, jintArray array, std::vector<cv::Rect>& regions)
+{
+    regions.clear();
+
+    if (!array)
+        return true;
+
+    const int len = env->GetArrayLength(array);
+    if (len % 4 != 0)
+        return false;
+
+    jint* values = env->GetIntArrayElements(array, 0);
+    for (int i = 0; i < len; i += 4)
+    {
+        regions.push_back(cv::Rect(values[i], values[i + 1], values[i + 2], values[i + 3]));
+    }
+    env->ReleaseIntArrayElements(array, values, JNI_ABORT);
+
+    return true;
+}
+
+static void clear_latency_control()
+{
+    delete g_controller;
+    g_controller = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        delete g_level_scrfd[i];
+        g_level_scrfd[i] = 0;
+    }
+}
+
+static jboolean load_model(JNIEnv* env, jobject assetManager, jint modelid, jint cpugpu, const SCRFDConfig& config)
+{
+    if (modelid < 0 || modelid > 7 || cpugpu < 0 || cpugpu > 1)
+    {
+        return JNI_FALSE;
+    }
+
+    AAssetManager* mgr = AAssetManager_fromJava(env, assetManager);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "loadModel %p", mgr);
+
+    const char* modeltype = modeltypes[(int)modelid];
+    bool use_gpu = (int)cpugpu == 1;
+
+    // reload
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        // manual model choice turns off the latency controller
+        clear_latency_control();
+
+        g_model_config = config;
+
+        if (use_gpu && ncnn::get_gpu_count() == 0)
+        {
+            // no gpu
+            delete g_scrfd;
+            g_scrfd = 0;
+        }
+        else
+        {
+            if (!g_scrfd)
+                g_scrfd = new SCRFD;
+            load_scrfd(g_scrfd, mgr, modeltype, use_gpu, config);
+        }
+    }
+    __android_log_print(ANDROID_LOG_DEBUG, "jb", "加载成功!!! %d", 1111);
+
+    return JNI_TRUE;
+}
+
 extern "C" {
 
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved)
@@ -164,6 +462,10 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 
         delete g_scrfd;
         g_scrfd = 0;
+
+        clear_latency_control();
+
+        g_recorder.close();
     }
 
     delete g_camera;
@@ -174,48 +476,351 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 JNIEXPORT jboolean JNICALL
 Java_com_tencent_scrfdncnn_SCRFDNcnn_loadModel(JNIEnv* env, jobject thiz, jobject assetManager, jint modelid, jint cpugpu)
 {
-    if (modelid < 0 || modelid > 7 || cpugpu < 0 || cpugpu > 1)
+    return load_model(env, assetManager, modelid, cpugpu, SCRFDConfig());
+}
+
+// public native boolean loadModelWithOptions(AssetManager mgr, int modelid, int cpugpu, int detflags, int detthreads, int lmkflags, int lmkthreads);
+JNIEXPORT jboolean JNICALL
+Java_com_tencent_scrfdncnn_SCRFDNcnn_loadModelWithOptions(JNIEnv* env, jobject thiz, jobject assetManager, jint modelid, jint cpugpu, jint detflags, jint detthreads, jint lmkflags, jint lmkthreads)
+{
+    if ((detflags & ~SCRFDNetConfig::ALL_FLAGS) || (lmkflags & ~SCRFDNetConfig::ALL_FLAGS) || detthreads < 0 || lmkthreads < 0)
     {
         return JNI_FALSE;
     }
 
-    AAssetManager* mgr = AAssetManager_fromJava(env, assetManager);
+    SCRFDConfig config;
+    config.detector.from_flags((int)detflags);
+    config.detector.num_threads = (int)detthreads;
+    config.landmark.from_flags((int)lmkflags);
+    config.landmark.num_threads = (int)lmkthreads;
 
-    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "loadModel %p", mgr);
+    return load_model(env, assetManager, modelid, cpugpu, config);
+}
+
+// public native boolean setTuneCachePath(String path);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setTuneCachePath(JNIEnv* env, jobject thiz, jstring path)
+{
+    const char* pathstr = env->GetStringUTFChars(path, 0);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setTuneCachePath %s", pathstr);
 
-    const char* modeltypes[] =
     {
-        "500m",
-        "500m_kps",
-        "1g",
-        "2.5g",
-        "2.5g_kps",
-        "10g",
-        "10g_kps",
-        "34g"
-    };
+        ncnn::MutexLockGuard g(lock);
 
-    const char* modeltype = modeltypes[(int)modelid];
-    bool use_gpu = (int)cpugpu == 1;
+        g_tune_cache_path = pathstr;
+    }
+
+    env->ReleaseStringUTFChars(path, pathstr);
+
+    return JNI_TRUE;
+}
+
+// public native boolean setThreadConfig(int detthreads, int detpowersave, int lmkthreads, int lmkpowersave, int camerapowersave);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setThreadConfig(JNIEnv* env, jobject thiz, jint detthreads, jint detpowersave, jint lmkthreads, jint lmkpowersave, jint camerapowersave)
+{
+    if (detthreads < 0 || lmkthreads < 0 || detpowersave < 0 || detpowersave > 2 || lmkpowersave < 0 || lmkpowersave > 2 || camerapowersave < 0 || camerapowersave > 2)
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setThreadConfig %d %d %d %d %d", detthreads, detpowersave, lmkthreads, lmkpowersave, camerapowersave);
 
-    // reload
     {
         ncnn::MutexLockGuard g(lock);
 
-        if (use_gpu && ncnn::get_gpu_count() == 0)
+        g_manual_threads = true;
+        g_manual_threads_config.detector.num_threads = detthreads;
+        g_manual_threads_config.detector.powersave = detpowersave;
+        g_manual_threads_config.landmark.num_threads = lmkthreads;
+        g_manual_threads_config.landmark.powersave = lmkpowersave;
+
+        if (g_scrfd)
+            g_scrfd->set_threads(detthreads, detpowersave, lmkthreads, lmkpowersave);
+
+        for (int i = 0; i < 8; i++)
         {
-            // no gpu
-            delete g_scrfd;
-            g_scrfd = 0;
+            if (g_level_scrfd[i])
+                g_level_scrfd[i]->set_threads(detthreads, detpowersave, lmkthreads, lmkpowersave);
         }
-        else
+    }
+
+    g_camera->camera_powersave = camerapowersave;
+
+    return JNI_TRUE;
+}
+
+// public native boolean setFaceSizeRange(int minsize, int maxsize);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setFaceSizeRange(JNIEnv* env, jobject thiz, jint minsize, jint maxsize)
+{
+    if (minsize < 0 || maxsize < 0 || (maxsize > 0 && maxsize < minsize))
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setFaceSizeRange %d %d", minsize, maxsize);
+
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        g_min_face_size = minsize;
+        g_max_face_size = maxsize;
+
+        if (g_scrfd)
+            g_scrfd->set_face_size_range(minsize, maxsize);
+
+        for (int i = 0; i < 8; i++)
         {
-            if (!g_scrfd)
-                g_scrfd = new SCRFD;
-            g_scrfd->load(mgr, modeltype, use_gpu);
+            if (g_level_scrfd[i])
+                g_level_scrfd[i]->set_face_size_range(minsize, maxsize);
         }
     }
-    __android_log_print(ANDROID_LOG_DEBUG, "jb", "加载成功!!! %d", 1111);
+
+    return JNI_TRUE;
+}
+
+// public native boolean setRegions(int[] include, int[] exclude);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setRegions(JNIEnv* env, jobject thiz, jintArray include, jintArray exclude)
+{
+    std::vector<cv::Rect> include_regions;
+    std::vector<cv::Rect> exclude_regions;
+    if (!get_regions(env, include, include_regions) || !get_regions(env, exclude, exclude_regions))
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setRegions %d %d", (int)include_regions.size(), (int)exclude_regions.size());
+
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        g_include_regions = include_regions;
+        g_exclude_regions = exclude_regions;
+
+        if (g_scrfd)
+            g_scrfd->set_regions(include_regions, exclude_regions);
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (g_level_scrfd[i])
+                g_level_scrfd[i]->set_regions(include_regions, exclude_regions);
+        }
+    }
+
+    return JNI_TRUE;
+}
+
+// public native boolean setLandmarkBudget(float budgetms, int priority);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setLandmarkBudget(JNIEnv* env, jobject thiz, jfloat budgetms, jint priority)
+{
+    if (budgetms < 0.f || priority < 0 || priority > 1)
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setLandmarkBudget %f %d", budgetms, priority);
+
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        g_landmark_budget_ms = budgetms;
+        g_landmark_priority = priority;
+
+        if (g_scrfd)
+            g_scrfd->set_landmark_budget(budgetms, priority);
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (g_level_scrfd[i])
+                g_level_scrfd[i]->set_landmark_budget(budgetms, priority);
+        }
+    }
+
+    return JNI_TRUE;
+}
+
+// public native boolean setMotionGate(float threshold, float facethreshold, int maxskip);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_setMotionGate(JNIEnv* env, jobject thiz, jfloat threshold, jfloat facethreshold, jint maxskip)
+{
+    if (threshold < 0.f || facethreshold < 0.f || maxskip < 0)
+        return JNI_FALSE;
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "setMotionGate %f %f %d", threshold, facethreshold, maxskip);
+
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        g_motion_gate.threshold = threshold;
+        g_motion_gate.region_threshold = facethreshold;
+        g_motion_gate.max_skip = maxskip;
+        g_motion_gate.reset();
+        g_motion_skip = false;
+    }
+
+    return JNI_TRUE;
+}
+
+// public native boolean enableLatencyControl(AssetManager mgr, int[] modelids, int[] targetsizes, int cpugpu, float targetms);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_enableLatencyControl(JNIEnv* env, jobject thiz, jobject assetManager, jintArray modelids, jintArray targetsizes, jint cpugpu, jfloat targetms)
+{
+    const int level_count = env->GetArrayLength(modelids);
+    if (level_count == 0 || level_count != env->GetArrayLength(targetsizes) || cpugpu < 0 || cpugpu > 1 || targetms <= 0.f)
+        return JNI_FALSE;
+
+    bool use_gpu = (int)cpugpu == 1;
+    if (use_gpu && ncnn::get_gpu_count() == 0)
+        return JNI_FALSE;
+
+    std::vector<LatencyLevel> levels(level_count);
+    {
+        jint* modelids_ptr = env->GetIntArrayElements(modelids, 0);
+        jint* targetsizes_ptr = env->GetIntArrayElements(targetsizes, 0);
+
+        for (int i = 0; i < level_count; i++)
+        {
+            levels[i].modelid = modelids_ptr[i];
+            levels[i].target_size = targetsizes_ptr[i];
+        }
+
+        env->ReleaseIntArrayElements(modelids, modelids_ptr, JNI_ABORT);
+        env->ReleaseIntArrayElements(targetsizes, targetsizes_ptr, JNI_ABORT);
+    }
+
+    for (int i = 0; i < level_count; i++)
+    {
+        if (levels[i].modelid < 0 || levels[i].modelid > 7 || levels[i].target_size < 32)
+            return JNI_FALSE;
+    }
+
+    AAssetManager* mgr = AAssetManager_fromJava(env, assetManager);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "enableLatencyControl %d levels %.1f ms", level_count, targetms);
+
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        clear_latency_control();
+
+        // preload every model on the ladder so that switching costs nothing
+        // only the first loads and tunes 2d106det, the detectors differ per level but the landmark net does not
+        const SCRFD* landmark_owner = 0;
+        for (int i = 0; i < level_count; i++)
+        {
+            const int modelid = levels[i].modelid;
+            if (g_level_scrfd[modelid])
+                continue;
+
+            g_level_scrfd[modelid] = new SCRFD;
+            g_level_scrfd[modelid]->share_landmark(landmark_owner);
+            load_scrfd(g_level_scrfd[modelid], mgr, modeltypes[modelid], use_gpu, g_model_config);
+
+            if (!landmark_owner)
+                landmark_owner = g_level_scrfd[modelid];
+        }
+
+        g_controller = new LatencyController;
+        g_controller->set_target(targetms);
+        g_controller->set_levels(levels);
+    }
+
+    return JNI_TRUE;
+}
+
+// public native float[] getLatencyControlMetrics();
+JNIEXPORT jfloatArray JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_getLatencyControlMetrics(JNIEnv* env, jobject thiz)
+{
+    LatencyControllerMetrics m;
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        if (!g_controller)
+            return 0;
+
+        m = g_controller->metrics();
+    }
+
+    const jfloat values[10] = {
+        (float)m.level, (float)m.modelid, (float)m.target_size, m.target_ms, m.last_ms, m.ema_ms,
+        (float)m.frames, (float)m.step_ups, (float)m.step_downs, (float)m.over_budget_frames
+    };
+
+    jfloatArray metrics = env->NewFloatArray(10);
+    env->SetFloatArrayRegion(metrics, 0, 10, values);
+
+    return metrics;
+}
+
+// public native float[] getMetrics();
+JNIEXPORT jfloatArray JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_getMetrics(JNIEnv* env, jobject thiz)
+{
+    MetricsSnapshot snapshot;
+    metrics_snapshot(snapshot);
+
+    // count mean p50 p90 p99 max per stage, then the counters
+    const int size = METRIC_STAGE_COUNT * 6 + METRIC_COUNTER_COUNT;
+
+    jfloat values[size];
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++)
+    {
+        const MetricStageSummary& summary = snapshot.stages[s];
+        values[s * 6 + 0] = (float)summary.count;
+        values[s * 6 + 1] = summary.mean;
+        values[s * 6 + 2] = summary.p50;
+        values[s * 6 + 3] = summary.p90;
+        values[s * 6 + 4] = summary.p99;
+        values[s * 6 + 5] = summary.max;
+    }
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        values[METRIC_STAGE_COUNT * 6 + c] = (float)snapshot.counters[c];
+    }
+
+    jfloatArray metrics = env->NewFloatArray(size);
+    env->SetFloatArrayRegion(metrics, 0, size, values);
+
+    return metrics;
+}
+
+// public native boolean resetMetrics();
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_resetMetrics(JNIEnv* env, jobject thiz)
+{
+    metrics_reset();
+
+    return JNI_TRUE;
+}
+
+// public native boolean dumpTrace(String path);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_dumpTrace(JNIEnv* env, jobject thiz, jstring path)
+{
+    const char* pathstr = env->GetStringUTFChars(path, 0);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "dumpTrace %s", pathstr);
+
+    int ret = trace_dump(pathstr);
+
+    env->ReleaseStringUTFChars(path, pathstr);
+
+    return ret == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+// public native boolean startRecording(String path);
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_startRecording(JNIEnv* env, jobject thiz, jstring path)
+{
+    const char* pathstr = env->GetStringUTFChars(path, 0);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "startRecording %s", pathstr);
+
+    int ret = 0;
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        ret = g_recorder.open(pathstr);
+    }
+
+    env->ReleaseStringUTFChars(path, pathstr);
+
+    return ret == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+// public native boolean stopRecording();
+JNIEXPORT jboolean JNICALL Java_com_tencent_scrfdncnn_SCRFDNcnn_stopRecording(JNIEnv* env, jobject thiz)
+{
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "stopRecording");
+
+    ncnn::MutexLockGuard g(lock);
+
+    g_recorder.close();
 
     return JNI_TRUE;
 }
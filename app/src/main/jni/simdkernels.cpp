@@ -0,0 +1,281 @@
+#include "simdkernels.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "cpu.h"
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+#if SCRFD_SIMD_X86
+// simdkernels_sse41.cpp and simdkernels_avx2.cpp, built with their own instruction set flags
+extern const SimdKernels simd_sse41_kernels;
+extern const SimdKernels simd_avx2_kernels;
+#endif // SCRFD_SIMD_X86
+
+static void rgb_to_rgba_scalar(const unsigned char* rgb, unsigned char* rgba, int n)
+{
+    for (int x = 0; x < n; x++)
+    {
+        rgba[0] = rgb[0];
+        rgba[1] = rgb[1];
+        rgba[2] = rgb[2];
+        rgba[3] = 255;
+
+        rgb += 3;
+        rgba += 4;
+    }
+}
+
+static int select_scores_scalar(const float* scores, int n, float threshold, int* indices)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        // ordered compare, nan scores are dropped
+        if (scores[i] >= threshold)
+            indices[count++] = i;
+    }
+
+    return count;
+}
+
+static void decode_boxes_scalar(const float* const bbox[4], const int* indices, int n, int w, float anchor_cx, float anchor_cy, float stride, float* boxes)
+{
+    for (int k = 0; k < n; k++)
+    {
+        const int index = indices[k];
+        const int i = index / w;
+        const int j = index - i * w;
+
+        const float cx = anchor_cx + j * stride;
+        const float cy = anchor_cy + i * stride;
+
+        boxes[0] = cx - bbox[0][index] * stride;
+        boxes[1] = cy - bbox[1][index] * stride;
+        boxes[2] = cx + bbox[2][index] * stride;
+        boxes[3] = cy + bbox[3][index] * stride;
+        boxes += 4;
+    }
+}
+
+static int iou_any_above_scalar(const float* x0, const float* y0, const float* x1, const float* y1, const float* areas, int n, const float box[4], float area, float threshold)
+{
+    for (int j = 0; j < n; j++)
+    {
+        // cv::Rect_ intersection
+        const float iw = std::min(box[2], x1[j]) - std::max(box[0], x0[j]);
+        const float ih = std::min(box[3], y1[j]) - std::max(box[1], y0[j]);
+        const float inter_area = iw > 0 && ih > 0 ? iw * ih : 0.f;
+        const float union_area = area + areas[j] - inter_area;
+        if (inter_area / union_area > threshold)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void affine_points_scalar(const float* xy, int n, float half, const float m[6], float* out)
+{
+    for (int i = 0; i < n; i++)
+    {
+        const float x = (xy[0] + 1) * half;
+        const float y = (xy[1] + 1) * half;
+
+        out[0] = m[0] * x + m[1] * y + m[2];
+        out[1] = m[3] * x + m[4] * y + m[5];
+
+        xy += 2;
+        out += 2;
+    }
+}
+
+static const SimdKernels simd_scalar_kernels = {
+    "scalar",
+    rgb_to_rgba_scalar,
+    select_scores_scalar,
+    decode_boxes_scalar,
+    iou_any_above_scalar,
+    affine_points_scalar
+};
+
+#if __ARM_NEON
+static void rgb_to_rgba_neon(const unsigned char* rgb, unsigned char* rgba, int n)
+{
+    int x = 0;
+    for (; x + 7 < n; x += 8)
+    {
+        uint8x8x3_t _rgb = vld3_u8(rgb);
+        uint8x8x4_t _rgba;
+        _rgba.val[0] = _rgb.val[0];
+        _rgba.val[1] = _rgb.val[1];
+        _rgba.val[2] = _rgb.val[2];
+        _rgba.val[3] = vdup_n_u8(255);
+        vst4_u8(rgba, _rgba);
+
+        rgb += 24;
+        rgba += 32;
+    }
+
+    rgb_to_rgba_scalar(rgb, rgba, n - x);
+}
+
+static int select_scores_neon(const float* scores, int n, float threshold, int* indices)
+{
+    const float32x4_t _threshold = vdupq_n_f32(threshold);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 3 < n; i += 4)
+    {
+        // most scores are far below threshold, test four at once and only then one by one
+        uint32x4_t _above = vcgeq_f32(vld1q_f32(scores + i), _threshold);
+        uint32x2_t _any = vorr_u32(vget_low_u32(_above), vget_high_u32(_above));
+        if (vget_lane_u32(vpmax_u32(_any, _any), 0) == 0)
+            continue;
+
+        const int first = count;
+        count += select_scores_scalar(scores + i, 4, threshold, indices + count);
+        for (int k = first; k < count; k++)
+            indices[k] += i;
+    }
+    for (; i < n; i++)
+    {
+        if (scores[i] >= threshold)
+            indices[count++] = i;
+    }
+
+    return count;
+}
+
+static int iou_any_above_neon(const float* x0, const float* y0, const float* x1, const float* y1, const float* areas, int n, const float box[4], float area, float threshold)
+{
+    const float32x4_t _bx0 = vdupq_n_f32(box[0]);
+    const float32x4_t _by0 = vdupq_n_f32(box[1]);
+    const float32x4_t _bx1 = vdupq_n_f32(box[2]);
+    const float32x4_t _by1 = vdupq_n_f32(box[3]);
+    const float32x4_t _area = vdupq_n_f32(area);
+    const float32x4_t _threshold = vdupq_n_f32(threshold);
+    const float32x4_t _zero = vdupq_n_f32(0.f);
+
+    int j = 0;
+    for (; j + 3 < n; j += 4)
+    {
+        float32x4_t _iw = vsubq_f32(vminq_f32(_bx1, vld1q_f32(x1 + j)), vmaxq_f32(_bx0, vld1q_f32(x0 + j)));
+        float32x4_t _ih = vsubq_f32(vminq_f32(_by1, vld1q_f32(y1 + j)), vmaxq_f32(_by0, vld1q_f32(y0 + j)));
+        uint32x4_t _overlap = vandq_u32(vcgtq_f32(_iw, _zero), vcgtq_f32(_ih, _zero));
+        float32x4_t _inter = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(_iw, _ih)), _overlap));
+        float32x4_t _union = vsubq_f32(vaddq_f32(_area, vld1q_f32(areas + j)), _inter);
+
+        // ieee division keeps the ratio bit exact with the scalar test, armv7 has only the estimate
+#if __aarch64__
+        float32x4_t _ratio = vdivq_f32(_inter, _union);
+#else
+        float inter[4];
+        float uni[4];
+        vst1q_f32(inter, _inter);
+        vst1q_f32(uni, _union);
+        for (int k = 0; k < 4; k++)
+            inter[k] = inter[k] / uni[k];
+        float32x4_t _ratio = vld1q_f32(inter);
+#endif // __aarch64__
+
+        uint32x4_t _above = vcgtq_f32(_ratio, _threshold);
+        uint32x2_t _any = vorr_u32(vget_low_u32(_above), vget_high_u32(_above));
+        if (vget_lane_u32(vpmax_u32(_any, _any), 0) != 0)
+            return 1;
+    }
+
+    return iou_any_above_scalar(x0 + j, y0 + j, x1 + j, y1 + j, areas + j, n - j, box, area, threshold);
+}
+
+static void affine_points_neon(const float* xy, int n, float half, const float m[6], float* out)
+{
+    const float32x4_t _one = vdupq_n_f32(1.f);
+    const float32x4_t _half = vdupq_n_f32(half);
+
+    int i = 0;
+    for (; i + 3 < n; i += 4)
+    {
+        float32x4x2_t _xy = vld2q_f32(xy);
+        float32x4_t _x = vmulq_f32(vaddq_f32(_xy.val[0], _one), _half);
+        float32x4_t _y = vmulq_f32(vaddq_f32(_xy.val[1], _one), _half);
+
+        float32x4x2_t _out;
+        _out.val[0] = vaddq_f32(vaddq_f32(vmulq_n_f32(_x, m[0]), vmulq_n_f32(_y, m[1])), vdupq_n_f32(m[2]));
+        _out.val[1] = vaddq_f32(vaddq_f32(vmulq_n_f32(_x, m[3]), vmulq_n_f32(_y, m[4])), vdupq_n_f32(m[5]));
+        vst2q_f32(out, _out);
+
+        xy += 8;
+        out += 8;
+    }
+
+    affine_points_scalar(xy, n - i, half, m, out);
+}
+
+static const SimdKernels simd_neon_kernels = {
+    "neon",
+    rgb_to_rgba_neon,
+    select_scores_neon,
+    decode_boxes_scalar,
+    iou_any_above_neon,
+    affine_points_neon
+};
+#endif // __ARM_NEON
+
+const SimdKernels* simd_backend_kernels(int backend)
+{
+    if (backend == SIMD_SCALAR)
+        return &simd_scalar_kernels;
+
+#if __ARM_NEON
+    if (backend == SIMD_NEON && ncnn::cpu_support_arm_neon())
+        return &simd_neon_kernels;
+#endif // __ARM_NEON
+
+#if SCRFD_SIMD_X86
+    if (backend == SIMD_SSE41 && __builtin_cpu_supports("sse4.1"))
+        return &simd_sse41_kernels;
+    if (backend == SIMD_AVX2 && __builtin_cpu_supports("avx2"))
+        return &simd_avx2_kernels;
+#endif // SCRFD_SIMD_X86
+
+    return 0;
+}
+
+int simd_best_backend()
+{
+    for (int backend = SIMD_BACKEND_COUNT - 1; backend > SIMD_SCALAR; backend--)
+    {
+        if (simd_backend_kernels(backend))
+            return backend;
+    }
+
+    return SIMD_SCALAR;
+}
+
+static std::atomic<const SimdKernels*> g_kernels(0);
+
+const SimdKernels& simd_kernels()
+{
+    const SimdKernels* kernels = g_kernels.load(std::memory_order_acquire);
+    if (!kernels)
+    {
+        kernels = simd_backend_kernels(simd_best_backend());
+        g_kernels.store(kernels, std::memory_order_release);
+    }
+
+    return *kernels;
+}
+
+int simd_set_backend(int backend)
+{
+    const SimdKernels* kernels = simd_backend_kernels(backend);
+    if (!kernels)
+        return -1;
+
+    g_kernels.store(kernels, std::memory_order_release);
+    return 0;
+}
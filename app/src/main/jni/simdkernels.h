@@ -0,0 +1,51 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+// project-owned vector kernels with scalar, neon, sse4.1 and avx2 backends
+// the best backend the cpu supports is picked on first use, simd_set_backend() overrides it
+// every backend matches the scalar one exactly for selection and iou, float math to rounding
+
+enum SimdBackend
+{
+    SIMD_SCALAR = 0,
+    SIMD_NEON,
+    SIMD_SSE41,
+    SIMD_AVX2,
+    SIMD_BACKEND_COUNT
+};
+
+struct SimdKernels
+{
+    const char* name;
+
+    // n rgb pixels to rgba with alpha 255
+    void (*rgb_to_rgba)(const unsigned char* rgb, unsigned char* rgba, int n);
+
+    // ascending indices of the scores >= threshold, nan never selected, returns their count
+    int (*select_scores)(const float* scores, int n, float threshold, int* indices);
+
+    // distance2bbox for the selected cells of one anchor plane of width w
+    // cell index i sits at anchor_cx + (i % w) * stride, anchor_cy + (i / w) * stride
+    // boxes gets x0 y0 x1 y1 per cell
+    void (*decode_boxes)(const float* const bbox[4], const int* indices, int n, int w, float anchor_cx, float anchor_cy, float stride, float* boxes);
+
+    // whether box overlaps any of the n boxes with iou above threshold, boxes as separate x0 y0 x1 y1 area arrays
+    int (*iou_any_above)(const float* x0, const float* y0, const float* x1, const float* y1, const float* areas, int n, const float box[4], float area, float threshold);
+
+    // n points (x, y) in [-1, 1] scaled by half around half, then through the 2x3 affine m
+    void (*affine_points)(const float* xy, int n, float half, const float m[6], float* out);
+};
+
+// kernels of the active backend
+const SimdKernels& simd_kernels();
+
+// kernels of one backend, null when it is not built in or the cpu lacks it
+const SimdKernels* simd_backend_kernels(int backend);
+
+// best backend available on this cpu
+int simd_best_backend();
+
+// switch the active backend, -1 when it is not available
+int simd_set_backend(int backend);
+
+#endif // SIMDKERNELS_H
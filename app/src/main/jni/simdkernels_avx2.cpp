@@ -0,0 +1,206 @@
+// avx2 backend of simdkernels.h, this file alone is built with -mavx2
+
+#include "simdkernels.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+static void rgb_to_rgba_avx2(const unsigned char* rgb, unsigned char* rgba, int n)
+{
+    const __m256i _shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                              0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i _alpha = _mm256_set1_epi32((int)0xff000000);
+
+    int x = 0;
+    // 8 pixels from two 16 byte loads 12 bytes apart, one per lane
+    for (; x + 9 < n; x += 8)
+    {
+        __m256i _p = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)rgb)), _mm_loadu_si128((const __m128i*)(rgb + 12)), 1);
+        _p = _mm256_shuffle_epi8(_p, _shuffle);
+        _mm256_storeu_si256((__m256i*)rgba, _mm256_or_si256(_p, _alpha));
+
+        rgb += 24;
+        rgba += 32;
+    }
+    for (; x < n; x++)
+    {
+        rgba[0] = rgb[0];
+        rgba[1] = rgb[1];
+        rgba[2] = rgb[2];
+        rgba[3] = 255;
+
+        rgb += 3;
+        rgba += 4;
+    }
+}
+
+static int select_scores_avx2(const float* scores, int n, float threshold, int* indices)
+{
+    const __m256 _threshold = _mm256_set1_ps(threshold);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 7 < n; i += 8)
+    {
+        // ordered compare, nan is dropped like in the scalar test
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(scores + i), _threshold, _CMP_GE_OQ));
+        while (mask)
+        {
+            const int k = __builtin_ctz(mask);
+            indices[count++] = i + k;
+            mask &= mask - 1;
+        }
+    }
+    for (; i < n; i++)
+    {
+        if (scores[i] >= threshold)
+            indices[count++] = i;
+    }
+
+    return count;
+}
+
+static void decode_boxes_avx2(const float* const bbox[4], const int* indices, int n, int w, float anchor_cx, float anchor_cy, float stride, float* boxes)
+{
+    const __m256 _stride = _mm256_set1_ps(stride);
+    const __m256 _anchor_cx = _mm256_set1_ps(anchor_cx);
+    const __m256 _anchor_cy = _mm256_set1_ps(anchor_cy);
+
+    int k = 0;
+    for (; k + 7 < n; k += 8)
+    {
+        const int* idx = indices + k;
+
+        int rows[8];
+        int cols[8];
+        for (int q = 0; q < 8; q++)
+        {
+            rows[q] = idx[q] / w;
+            cols[q] = idx[q] - rows[q] * w;
+        }
+
+        __m256 _cx = _mm256_add_ps(_anchor_cx, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)cols)), _stride));
+        __m256 _cy = _mm256_add_ps(_anchor_cy, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)rows)), _stride));
+
+        const __m256i _index = _mm256_loadu_si256((const __m256i*)idx);
+        __m256 _l = _mm256_i32gather_ps(bbox[0], _index, 4);
+        __m256 _t = _mm256_i32gather_ps(bbox[1], _index, 4);
+        __m256 _r = _mm256_i32gather_ps(bbox[2], _index, 4);
+        __m256 _b = _mm256_i32gather_ps(bbox[3], _index, 4);
+
+        __m256 _x0 = _mm256_sub_ps(_cx, _mm256_mul_ps(_l, _stride));
+        __m256 _y0 = _mm256_sub_ps(_cy, _mm256_mul_ps(_t, _stride));
+        __m256 _x1 = _mm256_add_ps(_cx, _mm256_mul_ps(_r, _stride));
+        __m256 _y1 = _mm256_add_ps(_cy, _mm256_mul_ps(_b, _stride));
+
+        // transpose to eight boxes of x0 y0 x1 y1, box q and q + 4 share a register before the lane permute
+        __m256 _t0 = _mm256_unpacklo_ps(_x0, _y0);
+        __m256 _t1 = _mm256_unpacklo_ps(_x1, _y1);
+        __m256 _t2 = _mm256_unpackhi_ps(_x0, _y0);
+        __m256 _t3 = _mm256_unpackhi_ps(_x1, _y1);
+        __m256 _b04 = _mm256_shuffle_ps(_t0, _t1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 _b15 = _mm256_shuffle_ps(_t0, _t1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 _b26 = _mm256_shuffle_ps(_t2, _t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 _b37 = _mm256_shuffle_ps(_t2, _t3, _MM_SHUFFLE(3, 2, 3, 2));
+        _mm256_storeu_ps(boxes, _mm256_permute2f128_ps(_b04, _b15, 0x20));
+        _mm256_storeu_ps(boxes + 8, _mm256_permute2f128_ps(_b26, _b37, 0x20));
+        _mm256_storeu_ps(boxes + 16, _mm256_permute2f128_ps(_b04, _b15, 0x31));
+        _mm256_storeu_ps(boxes + 24, _mm256_permute2f128_ps(_b26, _b37, 0x31));
+
+        boxes += 32;
+    }
+    for (; k < n; k++)
+    {
+        const int index = indices[k];
+        const int i = index / w;
+        const int j = index - i * w;
+
+        const float cx = anchor_cx + j * stride;
+        const float cy = anchor_cy + i * stride;
+
+        boxes[0] = cx - bbox[0][index] * stride;
+        boxes[1] = cy - bbox[1][index] * stride;
+        boxes[2] = cx + bbox[2][index] * stride;
+        boxes[3] = cy + bbox[3][index] * stride;
+        boxes += 4;
+    }
+}
+
+static int iou_any_above_avx2(const float* x0, const float* y0, const float* x1, const float* y1, const float* areas, int n, const float box[4], float area, float threshold)
+{
+    const __m256 _bx0 = _mm256_set1_ps(box[0]);
+    const __m256 _by0 = _mm256_set1_ps(box[1]);
+    const __m256 _bx1 = _mm256_set1_ps(box[2]);
+    const __m256 _by1 = _mm256_set1_ps(box[3]);
+    const __m256 _area = _mm256_set1_ps(area);
+    const __m256 _threshold = _mm256_set1_ps(threshold);
+    const __m256 _zero = _mm256_setzero_ps();
+
+    int j = 0;
+    for (; j + 7 < n; j += 8)
+    {
+        __m256 _iw = _mm256_sub_ps(_mm256_min_ps(_bx1, _mm256_loadu_ps(x1 + j)), _mm256_max_ps(_bx0, _mm256_loadu_ps(x0 + j)));
+        __m256 _ih = _mm256_sub_ps(_mm256_min_ps(_by1, _mm256_loadu_ps(y1 + j)), _mm256_max_ps(_by0, _mm256_loadu_ps(y0 + j)));
+        __m256 _overlap = _mm256_and_ps(_mm256_cmp_ps(_iw, _zero, _CMP_GT_OQ), _mm256_cmp_ps(_ih, _zero, _CMP_GT_OQ));
+        __m256 _inter = _mm256_and_ps(_mm256_mul_ps(_iw, _ih), _overlap);
+        __m256 _union = _mm256_sub_ps(_mm256_add_ps(_area, _mm256_loadu_ps(areas + j)), _inter);
+
+        if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_div_ps(_inter, _union), _threshold, _CMP_GT_OQ)))
+            return 1;
+    }
+    for (; j < n; j++)
+    {
+        const float iw = std::min(box[2], x1[j]) - std::max(box[0], x0[j]);
+        const float ih = std::min(box[3], y1[j]) - std::max(box[1], y0[j]);
+        const float inter_area = iw > 0 && ih > 0 ? iw * ih : 0.f;
+        const float union_area = area + areas[j] - inter_area;
+        if (inter_area / union_area > threshold)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void affine_points_avx2(const float* xy, int n, float half, const float m[6], float* out)
+{
+    const __m256 _one = _mm256_set1_ps(1.f);
+    const __m256 _half = _mm256_set1_ps(half);
+    // x y lanes against m0 m3 and m1 m4
+    const __m256 _mx = _mm256_setr_ps(m[0], m[3], m[0], m[3], m[0], m[3], m[0], m[3]);
+    const __m256 _my = _mm256_setr_ps(m[1], m[4], m[1], m[4], m[1], m[4], m[1], m[4]);
+    const __m256 _mb = _mm256_setr_ps(m[2], m[5], m[2], m[5], m[2], m[5], m[2], m[5]);
+
+    int i = 0;
+    for (; i + 3 < n; i += 4)
+    {
+        __m256 _p = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(xy), _one), _half);
+        __m256 _x = _mm256_shuffle_ps(_p, _p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m256 _y = _mm256_shuffle_ps(_p, _p, _MM_SHUFFLE(3, 3, 1, 1));
+        _mm256_storeu_ps(out, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_x, _mx), _mm256_mul_ps(_y, _my)), _mb));
+
+        xy += 8;
+        out += 8;
+    }
+    for (; i < n; i++)
+    {
+        const float x = (xy[0] + 1) * half;
+        const float y = (xy[1] + 1) * half;
+
+        out[0] = m[0] * x + m[1] * y + m[2];
+        out[1] = m[3] * x + m[4] * y + m[5];
+
+        xy += 2;
+        out += 2;
+    }
+}
+
+extern const SimdKernels simd_avx2_kernels;
+const SimdKernels simd_avx2_kernels = {
+    "avx2",
+    rgb_to_rgba_avx2,
+    select_scores_avx2,
+    decode_boxes_avx2,
+    iou_any_above_avx2,
+    affine_points_avx2
+};
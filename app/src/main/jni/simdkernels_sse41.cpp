@@ -0,0 +1,196 @@
+// sse4.1 backend of simdkernels.h, this file alone is built with -msse4.1
+
+#include "simdkernels.h"
+
+#include <smmintrin.h>
+
+#include <algorithm>
+
+static void rgb_to_rgba_sse41(const unsigned char* rgb, unsigned char* rgba, int n)
+{
+    const __m128i _shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i _alpha = _mm_set1_epi32((int)0xff000000);
+
+    int x = 0;
+    // 4 pixels from a 16 byte load, the last 4 bytes belong to the next group
+    for (; x + 5 < n; x += 4)
+    {
+        __m128i _p = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)rgb), _shuffle);
+        _mm_storeu_si128((__m128i*)rgba, _mm_or_si128(_p, _alpha));
+
+        rgb += 12;
+        rgba += 16;
+    }
+    for (; x < n; x++)
+    {
+        rgba[0] = rgb[0];
+        rgba[1] = rgb[1];
+        rgba[2] = rgb[2];
+        rgba[3] = 255;
+
+        rgb += 3;
+        rgba += 4;
+    }
+}
+
+static int select_scores_sse41(const float* scores, int n, float threshold, int* indices)
+{
+    const __m128 _threshold = _mm_set1_ps(threshold);
+
+    int count = 0;
+    int i = 0;
+    for (; i + 3 < n; i += 4)
+    {
+        // ordered compare, nan is dropped like in the scalar test
+        int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(scores + i), _threshold));
+        while (mask)
+        {
+            const int k = __builtin_ctz(mask);
+            indices[count++] = i + k;
+            mask &= mask - 1;
+        }
+    }
+    for (; i < n; i++)
+    {
+        if (scores[i] >= threshold)
+            indices[count++] = i;
+    }
+
+    return count;
+}
+
+static void decode_boxes_sse41(const float* const bbox[4], const int* indices, int n, int w, float anchor_cx, float anchor_cy, float stride, float* boxes)
+{
+    const __m128 _stride = _mm_set1_ps(stride);
+    const __m128 _anchor_cx = _mm_set1_ps(anchor_cx);
+    const __m128 _anchor_cy = _mm_set1_ps(anchor_cy);
+
+    int k = 0;
+    for (; k + 3 < n; k += 4)
+    {
+        const int* idx = indices + k;
+
+        int rows[4];
+        int cols[4];
+        for (int q = 0; q < 4; q++)
+        {
+            rows[q] = idx[q] / w;
+            cols[q] = idx[q] - rows[q] * w;
+        }
+
+        __m128 _cx = _mm_add_ps(_anchor_cx, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)cols)), _stride));
+        __m128 _cy = _mm_add_ps(_anchor_cy, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)rows)), _stride));
+
+        __m128 _l = _mm_setr_ps(bbox[0][idx[0]], bbox[0][idx[1]], bbox[0][idx[2]], bbox[0][idx[3]]);
+        __m128 _t = _mm_setr_ps(bbox[1][idx[0]], bbox[1][idx[1]], bbox[1][idx[2]], bbox[1][idx[3]]);
+        __m128 _r = _mm_setr_ps(bbox[2][idx[0]], bbox[2][idx[1]], bbox[2][idx[2]], bbox[2][idx[3]]);
+        __m128 _b = _mm_setr_ps(bbox[3][idx[0]], bbox[3][idx[1]], bbox[3][idx[2]], bbox[3][idx[3]]);
+
+        __m128 _x0 = _mm_sub_ps(_cx, _mm_mul_ps(_l, _stride));
+        __m128 _y0 = _mm_sub_ps(_cy, _mm_mul_ps(_t, _stride));
+        __m128 _x1 = _mm_add_ps(_cx, _mm_mul_ps(_r, _stride));
+        __m128 _y1 = _mm_add_ps(_cy, _mm_mul_ps(_b, _stride));
+
+        // four boxes of x0 y0 x1 y1
+        _MM_TRANSPOSE4_PS(_x0, _y0, _x1, _y1);
+        _mm_storeu_ps(boxes, _x0);
+        _mm_storeu_ps(boxes + 4, _y0);
+        _mm_storeu_ps(boxes + 8, _x1);
+        _mm_storeu_ps(boxes + 12, _y1);
+
+        boxes += 16;
+    }
+    for (; k < n; k++)
+    {
+        const int index = indices[k];
+        const int i = index / w;
+        const int j = index - i * w;
+
+        const float cx = anchor_cx + j * stride;
+        const float cy = anchor_cy + i * stride;
+
+        boxes[0] = cx - bbox[0][index] * stride;
+        boxes[1] = cy - bbox[1][index] * stride;
+        boxes[2] = cx + bbox[2][index] * stride;
+        boxes[3] = cy + bbox[3][index] * stride;
+        boxes += 4;
+    }
+}
+
+static int iou_any_above_sse41(const float* x0, const float* y0, const float* x1, const float* y1, const float* areas, int n, const float box[4], float area, float threshold)
+{
+    const __m128 _bx0 = _mm_set1_ps(box[0]);
+    const __m128 _by0 = _mm_set1_ps(box[1]);
+    const __m128 _bx1 = _mm_set1_ps(box[2]);
+    const __m128 _by1 = _mm_set1_ps(box[3]);
+    const __m128 _area = _mm_set1_ps(area);
+    const __m128 _threshold = _mm_set1_ps(threshold);
+    const __m128 _zero = _mm_setzero_ps();
+
+    int j = 0;
+    for (; j + 3 < n; j += 4)
+    {
+        __m128 _iw = _mm_sub_ps(_mm_min_ps(_bx1, _mm_loadu_ps(x1 + j)), _mm_max_ps(_bx0, _mm_loadu_ps(x0 + j)));
+        __m128 _ih = _mm_sub_ps(_mm_min_ps(_by1, _mm_loadu_ps(y1 + j)), _mm_max_ps(_by0, _mm_loadu_ps(y0 + j)));
+        __m128 _overlap = _mm_and_ps(_mm_cmpgt_ps(_iw, _zero), _mm_cmpgt_ps(_ih, _zero));
+        __m128 _inter = _mm_and_ps(_mm_mul_ps(_iw, _ih), _overlap);
+        __m128 _union = _mm_sub_ps(_mm_add_ps(_area, _mm_loadu_ps(areas + j)), _inter);
+
+        if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_div_ps(_inter, _union), _threshold)))
+            return 1;
+    }
+    for (; j < n; j++)
+    {
+        const float iw = std::min(box[2], x1[j]) - std::max(box[0], x0[j]);
+        const float ih = std::min(box[3], y1[j]) - std::max(box[1], y0[j]);
+        const float inter_area = iw > 0 && ih > 0 ? iw * ih : 0.f;
+        const float union_area = area + areas[j] - inter_area;
+        if (inter_area / union_area > threshold)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void affine_points_sse41(const float* xy, int n, float half, const float m[6], float* out)
+{
+    const __m128 _one = _mm_set1_ps(1.f);
+    const __m128 _half = _mm_set1_ps(half);
+    // x y x y lanes against m0 m3 m0 m3 and m1 m4 m1 m4
+    const __m128 _mx = _mm_setr_ps(m[0], m[3], m[0], m[3]);
+    const __m128 _my = _mm_setr_ps(m[1], m[4], m[1], m[4]);
+    const __m128 _mb = _mm_setr_ps(m[2], m[5], m[2], m[5]);
+
+    int i = 0;
+    for (; i + 1 < n; i += 2)
+    {
+        __m128 _p = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(xy), _one), _half);
+        __m128 _x = _mm_shuffle_ps(_p, _p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 _y = _mm_shuffle_ps(_p, _p, _MM_SHUFFLE(3, 3, 1, 1));
+        _mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_x, _mx), _mm_mul_ps(_y, _my)), _mb));
+
+        xy += 4;
+        out += 4;
+    }
+    for (; i < n; i++)
+    {
+        const float x = (xy[0] + 1) * half;
+        const float y = (xy[1] + 1) * half;
+
+        out[0] = m[0] * x + m[1] * y + m[2];
+        out[1] = m[3] * x + m[4] * y + m[5];
+
+        xy += 2;
+        out += 2;
+    }
+}
+
+extern const SimdKernels simd_sse41_kernels;
+const SimdKernels simd_sse41_kernels = {
+    "sse4.1",
+    rgb_to_rgba_sse41,
+    select_scores_sse41,
+    decode_boxes_sse41,
+    iou_any_above_sse41,
+    affine_points_sse41
+};
@@ -0,0 +1,134 @@
+#include "threadpool.h"
+
+WorkStealingPool::WorkStealingPool(int num_workers)
+{
+    if (num_workers < 1)
+        num_workers = 1;
+
+    queued = 0;
+    pending = 0;
+    next_queue = 0;
+    stop = false;
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        queues.push_back(new TaskQueue);
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        threads.push_back(std::thread(&WorkStealingPool::worker_main, this, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::unique_lock<std::mutex> g(lock);
+        stop = true;
+    }
+    task_cond.notify_all();
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        delete queues[i];
+    }
+}
+
+void WorkStealingPool::submit(const Task& task)
+{
+    int q;
+    {
+        std::unique_lock<std::mutex> g(lock);
+        pending++;
+        q = next_queue;
+        next_queue = (next_queue + 1) % (int)queues.size();
+    }
+
+    {
+        std::unique_lock<std::mutex> g(queues[q]->lock);
+        queues[q]->tasks.push_back(task);
+    }
+
+    {
+        std::unique_lock<std::mutex> g(lock);
+        queued++;
+    }
+    task_cond.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> g(lock);
+    while (pending > 0)
+    {
+        done_cond.wait(g);
+    }
+}
+
+bool WorkStealingPool::pop_task(int id, Task& task)
+{
+    const int num_queues = (int)queues.size();
+
+    // own deque, newest first
+    {
+        TaskQueue* q = queues[id];
+        std::unique_lock<std::mutex> g(q->lock);
+        if (!q->tasks.empty())
+        {
+            task = q->tasks.back();
+            q->tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    // steal the oldest from the others
+    for (int i = 1; i < num_queues; i++)
+    {
+        TaskQueue* q = queues[(id + i) % num_queues];
+        std::unique_lock<std::mutex> g(q->lock);
+        if (!q->tasks.empty())
+        {
+            task = q->tasks.front();
+            q->tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingPool::worker_main(int id)
+{
+    for (;;)
+    {
+        Task task;
+        if (pop_task(id, task))
+        {
+            task(id);
+
+            std::unique_lock<std::mutex> g(lock);
+            pending--;
+            if (pending == 0)
+                done_cond.notify_all();
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> g(lock);
+        while (!stop && queued == 0)
+        {
+            task_cond.wait(g);
+        }
+
+        if (stop && queued == 0)
+            return;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of workers, each with its own task deque
+// a worker takes the newest task from its own deque and steals the oldest from the others when idle
+class WorkStealingPool
+{
+public:
+    // task receives the index of the worker running it, for per-worker state
+    typedef std::function<void(int)> Task;
+
+    explicit WorkStealingPool(int num_workers);
+    ~WorkStealingPool();
+
+    int size() const { return (int)threads.size(); }
+
+    // tasks are spread round-robin over the worker deques
+    void submit(const Task& task);
+
+    // block until every submitted task has finished
+    void wait();
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void worker_main(int id);
+    bool pop_task(int id, Task& task);
+
+    std::vector<TaskQueue*> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable task_cond;
+    std::condition_variable done_cond;
+
+    std::atomic<int> queued;
+    int pending;
+    int next_queue;
+    bool stop;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,299 @@
+#include "tiledetect.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "trace.h"
+
+TiledDetector::TiledDetector(const SCRFD& _scrfd, int workers) : scrfd(_scrfd), pool(workers)
+{
+    scale = 1.f;
+    tile_size = 640;
+    overlap = 96;
+    global_pass = true;
+
+    for (int i = 0; i < pool.size(); i++)
+    {
+        SCRFDContext* ctx = new SCRFDContext;
+        ctx->detector_threads = 1;
+        ctx->landmark_threads = 1;
+        contexts.push_back(ctx);
+    }
+
+    cut_faces.resize(pool.size());
+}
+
+TiledDetector::~TiledDetector()
+{
+    pool.wait();
+
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        delete contexts[i];
+    }
+}
+
+// tile origins along one axis, evenly stepped with the last tile flush to the far edge
+static void layout_axis(int length, int tile, int overlap, std::vector<int>& origins)
+{
+    origins.clear();
+
+    if (length <= tile)
+    {
+        origins.push_back(0);
+        return;
+    }
+
+    const int step = std::max(tile - overlap, 1);
+    const int count = (int)ceil((float)(length - tile) / step) + 1;
+    for (int i = 0; i < count; i++)
+    {
+        origins.push_back(std::min(i * step, length - tile));
+    }
+}
+
+void TiledDetector::layout(int width, int height, std::vector<cv::Rect>& _tiles) const
+{
+    // tile and overlap in rgb pixels
+    const int tile = (int)(tile_size / scale);
+    const int over = (int)(overlap / scale);
+
+    std::vector<int> xs;
+    std::vector<int> ys;
+    layout_axis(width, tile, over, xs);
+    layout_axis(height, tile, over, ys);
+
+    _tiles.clear();
+    for (size_t i = 0; i < ys.size(); i++)
+    {
+        for (size_t j = 0; j < xs.size(); j++)
+        {
+            _tiles.push_back(cv::Rect(xs[j], ys[i], std::min(tile, width), std::min(tile, height)));
+        }
+    }
+}
+
+enum
+{
+    CUT_LEFT    = 1,
+    CUT_TOP     = 2,
+    CUT_RIGHT   = 4,
+    CUT_BOTTOM  = 8
+};
+
+// the tile borders the box reaches that are not also frame borders, 0 = seen whole
+static int cut_by_inner_border(const FaceObject& obj, const cv::Rect& tile, int width, int height, float tolerance)
+{
+    int sides = 0;
+    if (tile.x > 0 && obj.rect.x < tile.x + tolerance)
+        sides |= CUT_LEFT;
+    if (tile.y > 0 && obj.rect.y < tile.y + tolerance)
+        sides |= CUT_TOP;
+    if (tile.x + tile.width < width && obj.rect.x + obj.rect.width > tile.x + tile.width - tolerance)
+        sides |= CUT_RIGHT;
+    if (tile.y + tile.height < height && obj.rect.y + obj.rect.height > tile.y + tile.height - tolerance)
+        sides |= CUT_BOTTOM;
+
+    return sides;
+}
+
+// part a cut at the far border of its tile and part b cut at the near border of a tile starting inside it
+// are one face when they meet in the overlap strip and overlap along the border by half of the shorter
+// a_end b_start across the border, [a0, a1) [b0, b1) along it
+static bool same_face_across(float a_end, float b_start, int a_border, int b_border, float a0, float a1, float b0, float b1)
+{
+    if (b_border >= a_border || b_start > a_end)
+        return false;
+
+    const float overlap = std::min(a1, b1) - std::max(a0, b0);
+    return overlap > 0.5f * std::min(a1 - a0, b1 - b0);
+}
+
+void TiledDetector::merge_cut_faces(std::vector<FaceObject>& proposals, float max_cut_size)
+{
+    std::vector<CutFace> faces;
+    for (size_t i = 0; i < cut_faces.size(); i++)
+    {
+        faces.insert(faces.end(), cut_faces[i].begin(), cut_faces[i].end());
+    }
+
+    std::vector<bool> merged(faces.size(), false);
+    std::vector<bool> joined(faces.size(), false);
+
+    // a face over a tile corner is cut in up to four parts, merge pairwise until nothing changes
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = 0; i < faces.size(); i++)
+        {
+            if (merged[i])
+                continue;
+
+            for (size_t j = 0; j < faces.size(); j++)
+            {
+                if (i == j || merged[j])
+                    continue;
+
+                CutFace& a = faces[i];
+                const CutFace& b = faces[j];
+
+                const cv::Rect_<float>& ra = a.obj.rect;
+                const cv::Rect_<float>& rb = b.obj.rect;
+
+                int a_side = 0;
+                int b_side = 0;
+                if ((a.sides & CUT_RIGHT) && (b.sides & CUT_LEFT)
+                        && same_face_across(ra.x + ra.width, rb.x, a.tile.x + a.tile.width, b.tile.x, ra.y, ra.y + ra.height, rb.y, rb.y + rb.height))
+                {
+                    a_side = CUT_RIGHT;
+                    b_side = CUT_LEFT;
+                }
+                else if ((a.sides & CUT_BOTTOM) && (b.sides & CUT_TOP)
+                        && same_face_across(ra.y + ra.height, rb.y, a.tile.y + a.tile.height, b.tile.y, ra.x, ra.x + ra.width, rb.x, rb.x + rb.width))
+                {
+                    a_side = CUT_BOTTOM;
+                    b_side = CUT_TOP;
+                }
+                else
+                {
+                    continue;
+                }
+
+                // union box, keypoints and score of the more confident part
+                const float x0 = std::min(ra.x, rb.x);
+                const float y0 = std::min(ra.y, rb.y);
+                const float x1 = std::max(ra.x + ra.width, rb.x + rb.width);
+                const float y1 = std::max(ra.y + ra.height, rb.y + rb.height);
+
+                if (b.obj.prob > a.obj.prob)
+                    a.obj = b.obj;
+
+                a.obj.rect = cv::Rect_<float>(x0, y0, x1 - x0, y1 - y0);
+                a.sides = (a.sides & ~a_side) | (b.sides & ~b_side);
+                a.tile = a.tile | b.tile;
+
+                merged[j] = true;
+                joined[i] = true;
+                changed = true;
+            }
+        }
+    }
+
+    // a small part left alone is a face seen whole by a neighbour tile, a large one is the best there is
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const cv::Rect_<float>& r = faces[i].obj.rect;
+        if (!merged[i] && (joined[i] || std::max(r.width, r.height) >= max_cut_size))
+            proposals.push_back(faces[i].obj);
+    }
+}
+
+int TiledDetector::detect(SCRFDContext& ctx, const cv::Mat& rgb, FrameResult& result, float prob_threshold, float nms_threshold)
+{
+    SCRFD_TRACE_SCOPE("detect_tiled");
+
+    const int width = rgb.cols;
+    const int height = rgb.rows;
+
+    layout(width, height, tiles);
+
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        contexts[i]->workspace.proposals.clear();
+        cut_faces[i].clear();
+    }
+
+    // faces under the overlap are seen whole by some tile, one stride 8 cell of slack at the border
+    const float max_cut_size = overlap / scale;
+    const float tolerance = 8 / scale;
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        pool.submit([&, i](int worker) {
+            SCRFD_TRACE_SCOPE("tile");
+
+            scrfd.bind_thread();
+
+            SCRFDContext& tctx = *contexts[worker];
+            std::vector<FaceObject>& proposals = tctx.workspace.proposals;
+
+            const cv::Rect& tile = tiles[i];
+
+            const int w = std::max((int)(tile.width * scale), 1);
+            const int h = std::max((int)(tile.height * scale), 1);
+
+            const size_t first = proposals.size();
+
+            scrfd.detect_region(tctx, rgb(tile), 1, w, h, scale, tile.tl(), prob_threshold);
+
+            size_t n = first;
+            for (size_t j = first; j < proposals.size(); j++)
+            {
+                const FaceObject& obj = proposals[j];
+                const int sides = cut_by_inner_border(obj, tile, width, height, tolerance);
+                if (sides)
+                {
+                    // the global pass sees every face larger than the overlap whole
+                    if (global_pass)
+                        continue;
+
+                    CutFace cut;
+                    cut.obj = obj;
+                    cut.tile = tile;
+                    cut.sides = sides;
+                    cut_faces[worker].push_back(cut);
+                    continue;
+                }
+
+                proposals[n++] = obj;
+            }
+            proposals.resize(n);
+        });
+    }
+
+    std::vector<FaceObject>& proposals = ctx.workspace.proposals;
+    proposals.clear();
+
+    // large faces at the usual detect() scale, on the caller thread while the tiles run
+    if (global_pass)
+    {
+        const int target_size = ctx.target_size > 0 ? ctx.target_size : scrfd.get_config().target_size;
+
+        int w = width;
+        int h = height;
+        float gscale = 1.f;
+        if (w > h)
+        {
+            gscale = (float)target_size / w;
+            w = target_size;
+            h = h * gscale;
+        }
+        else
+        {
+            gscale = (float)target_size / h;
+            h = target_size;
+            w = w * gscale;
+        }
+
+        scrfd.detect_region(ctx, rgb, 1, w, h, gscale, cv::Point(0, 0), prob_threshold);
+    }
+
+    pool.wait();
+
+    for (size_t i = 0; i < contexts.size(); i++)
+    {
+        const std::vector<FaceObject>& tile_proposals = contexts[i]->workspace.proposals;
+        proposals.insert(proposals.end(), tile_proposals.begin(), tile_proposals.end());
+    }
+
+    if (!global_pass)
+        merge_cut_faces(proposals, max_cut_size);
+
+    // one nms over all tiles merges the faces seen by several of them
+    scrfd.finish_detect(ctx, rgb, 1, result, nms_threshold);
+
+    return 0;
+}
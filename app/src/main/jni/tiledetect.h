@@ -0,0 +1,67 @@
+#ifndef TILEDETECT_H
+#define TILEDETECT_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "scrfd.h"
+#include "threadpool.h"
+
+// detection on large frames as overlapping tiles at a chosen scale, tiles run in parallel
+// proposals of all tiles merge in one nms on the caller context, landmarks then run once per face
+// faces cut by an inner tile border never go to nms as they are
+// with the global pass they are all dropped, faces under the overlap are whole in a neighbour tile and larger ones in the global pass
+// without it the parts cut at the two sides of one overlap strip are merged into one box, small parts left alone are dropped
+// include_regions of SCRFDConfig are not used here, exclude_regions and the face size range are
+class TiledDetector
+{
+public:
+    // one single-threaded SCRFDContext per pool worker
+    TiledDetector(const SCRFD& scrfd, int workers);
+    ~TiledDetector();
+
+    int detect(SCRFDContext& ctx, const cv::Mat& rgb, FrameResult& result, float prob_threshold = 0.5f, float nms_threshold = 0.45f);
+
+    // tile rects in rgb pixels for a width x height frame
+    void layout(int width, int height, std::vector<cv::Rect>& tiles) const;
+
+    int workers() const { return pool.size(); }
+
+public:
+    // frame scale before tiling, 1 = native resolution
+    float scale;
+
+    // tile side in detector input pixels, multiple of 32
+    int tile_size;
+
+    // tile overlap in detector input pixels, should exceed the largest face the tiles must find
+    int overlap;
+
+    // also run the whole frame at target_size, for faces larger than the overlap
+    bool global_pass;
+
+private:
+    TiledDetector(const TiledDetector&);
+    TiledDetector& operator=(const TiledDetector&);
+
+    // a face reaching inner tile borders, sides as CUT_* bits
+    struct CutFace
+    {
+        FaceObject obj;
+        cv::Rect tile;
+        int sides;
+    };
+
+    void merge_cut_faces(std::vector<FaceObject>& proposals, float max_cut_size);
+
+    const SCRFD& scrfd;
+    WorkStealingPool pool;
+    std::vector<SCRFDContext*> contexts;
+    std::vector<cv::Rect> tiles;
+
+    // per worker, cut faces kept for merge_cut_faces() when there is no global pass
+    std::vector<std::vector<CutFace> > cut_faces;
+};
+
+#endif // TILEDETECT_H
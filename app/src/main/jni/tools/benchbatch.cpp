@@ -0,0 +1,93 @@
+// throughput of SCRFD::detect_batch mosaics against one SCRFD::detect call per image
+// every batch holds copies of the same image, so both paths should report the same faces per image
+//
+// usage: benchbatch [modeltype] [imagepath] [target_size] [maxbatch] [loops]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+
+#include "scrfd.h"
+
+int main(int argc, char** argv)
+{
+    const char* modeltype = argc > 1 ? argv[1] : "500m_kps";
+    const char* imagepath = argc > 2 ? argv[2] : 0;
+    int target_size = argc > 3 ? atoi(argv[3]) : 120;
+    int maxbatch = argc > 4 ? atoi(argv[4]) : 16;
+    int loops = argc > 5 ? atoi(argv[5]) : 50;
+
+    cv::Mat rgb;
+    if (imagepath)
+    {
+        cv::Mat bgr = cv::imread(imagepath, 1);
+        if (bgr.empty())
+        {
+            fprintf(stderr, "cv::imread %s failed\n", imagepath);
+            return -1;
+        }
+
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    }
+    else
+    {
+        rgb.create(480, 640, CV_8UC3);
+        srand(0);
+        for (size_t i = 0; i < rgb.total() * 3; i++)
+        {
+            rgb.data[i] = rand() % 256;
+        }
+    }
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+    scrfd.set_target_size(target_size);
+
+    SCRFDContext ctx;
+
+    fprintf(stdout, "%6s %14s %14s %8s %10s %10s\n", "batch", "single img/s", "mosaic img/s", "speedup", "faces", "faces_mos");
+
+    for (int batch = 1; batch <= maxbatch; batch *= 2)
+    {
+        std::vector<cv::Mat> rgbs(batch, rgb);
+        std::vector<FrameResult> results(batch);
+        std::vector<FrameResult> batch_results;
+
+        // warm up both paths
+        for (int i = 0; i < batch; i++)
+            scrfd.detect(ctx, rgbs[i], results[i]);
+        scrfd.detect_batch(ctx, rgbs, batch_results);
+
+        double t0 = ncnn::get_current_time();
+
+        for (int l = 0; l < loops; l++)
+        {
+            for (int i = 0; i < batch; i++)
+                scrfd.detect(ctx, rgbs[i], results[i]);
+        }
+
+        double t1 = ncnn::get_current_time();
+
+        for (int l = 0; l < loops; l++)
+        {
+            scrfd.detect_batch(ctx, rgbs, batch_results);
+        }
+
+        double t2 = ncnn::get_current_time();
+
+        const double single = batch * loops * 1000.0 / (t1 - t0);
+        const double mosaic = batch * loops * 1000.0 / (t2 - t1);
+
+        fprintf(stdout, "%6d %14.2f %14.2f %7.2fx %10d %10d\n", batch, single, mosaic, mosaic / single, results[0].face_count(), batch_results[batch - 1].face_count());
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+// detect latency of every model variant with face size ranges that skip stride heads
+//
+// usage: benchfacesize [imagepath] [targetsize] [loops]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+#include <cpu.h>
+
+#include "scrfd.h"
+
+static const char* modeltypes[] =
+{
+    "500m",
+    "500m_kps",
+    "1g",
+    "2.5g",
+    "2.5g_kps",
+    "10g",
+    "10g_kps",
+    "34g"
+};
+
+// face long side range in net input pixels, see scrfd_heads in scrfd.cpp
+struct SizeRange
+{
+    const char* name;
+    int min_size;
+    int max_size;
+};
+
+static const SizeRange ranges[] =
+{
+    {"all", 0, 0},
+    {"no_s8", 65, 0},
+    {"s32", 257, 0},
+    {"s8", 0, 31}
+};
+
+static bool file_exists(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* imagepath = argc > 1 ? argv[1] : 0;
+    int target_size = argc > 2 ? atoi(argv[2]) : 320;
+    int loops = argc > 3 ? atoi(argv[3]) : 20;
+
+    if (loops < 1)
+        loops = 1;
+
+    cv::Mat rgb;
+    if (imagepath)
+    {
+        cv::Mat bgr = cv::imread(imagepath, 1);
+        if (bgr.empty())
+        {
+            fprintf(stderr, "cv::imread %s failed\n", imagepath);
+            return -1;
+        }
+
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    }
+    else
+    {
+        rgb.create(480, 640, CV_8UC3);
+        srand(0);
+        for (size_t i = 0; i < rgb.total() * 3; i++)
+        {
+            rgb.data[i] = rand() % 256;
+        }
+    }
+
+    // net input pixels to image pixels
+    const float scale = (float)std::max(rgb.cols, rgb.rows) / target_size;
+
+    fprintf(stdout, "%-10s %-6s %8s %8s %10s %10s %6s\n", "model", "range", "min_px", "max_px", "avg_ms", "speedup", "faces");
+
+    for (size_t m = 0; m < sizeof(modeltypes) / sizeof(modeltypes[0]); m++)
+    {
+        const char* modeltype = modeltypes[m];
+
+        char parampath[256];
+        sprintf(parampath, "scrfd_%s-opt2.param", modeltype);
+        if (!file_exists(parampath))
+        {
+            fprintf(stderr, "skip %s, no %s\n", modeltype, parampath);
+            continue;
+        }
+
+        SCRFDConfig config;
+        config.target_size = target_size;
+
+        SCRFD scrfd;
+        scrfd.load(modeltype, false, config);
+
+        double base_ms = 0;
+        for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++)
+        {
+            const int min_face_size = (int)(ranges[r].min_size * scale + 0.5f);
+            const int max_face_size = (int)(ranges[r].max_size * scale + 0.5f);
+            scrfd.set_face_size_range(min_face_size, max_face_size);
+
+            FrameResult result;
+
+            // warmup
+            scrfd.detect(rgb, result);
+
+            double start = ncnn::get_current_time();
+            for (int i = 0; i < loops; i++)
+            {
+                scrfd.detect(rgb, result);
+            }
+            double avg_ms = (ncnn::get_current_time() - start) / loops;
+
+            if (r == 0)
+                base_ms = avg_ms;
+
+            fprintf(stdout, "%-10s %-6s %8d %8d %10.3f %10.2f %6d\n", modeltype, ranges[r].name, min_face_size, max_face_size, avg_ms, base_ms / avg_ms, result.face_count());
+        }
+    }
+
+    return 0;
+}
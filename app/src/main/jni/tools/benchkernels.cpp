@@ -0,0 +1,276 @@
+// microbenchmarks of the non-model hot paths on synthetic inputs
+// one json object per line, eg. for appending to a per-commit log
+//   {"tag":"3d0d854","kernel":"nms","case":"n=1000","iters":2048,"us":123.456}
+// us is the median over 5 repeats of the mean time per call
+//
+// usage: benchkernels [tag] [filter] [simd]
+// filter runs only kernels whose name contains it
+// simd forces a backend of simdkernels.h, 0=scalar 1=neon 2=sse4.1 3=avx2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <benchmark.h>
+#include <mat.h>
+
+#include "pixelconvert.h"
+#include "scrfd.h"
+#include "scrfdkernels.h"
+#include "simdkernels.h"
+
+static const char* g_tag = "";
+static const char* g_filter = 0;
+
+// time fn until one repeat takes at least 50ms, report median of 5 repeats in us per call
+template<typename F>
+static void run(const char* kernel, const char* name, F fn)
+{
+    if (g_filter && !strstr(kernel, g_filter))
+        return;
+
+    // warmup and calibrate
+    int iters = 1;
+    for (;;)
+    {
+        double start = ncnn::get_current_time();
+        for (int i = 0; i < iters; i++)
+            fn();
+        double ms = ncnn::get_current_time() - start;
+
+        if (ms >= 50 || iters >= (1 << 24))
+            break;
+
+        iters *= 2;
+    }
+
+    std::vector<double> times;
+    for (int r = 0; r < 5; r++)
+    {
+        double start = ncnn::get_current_time();
+        for (int i = 0; i < iters; i++)
+            fn();
+        times.push_back((ncnn::get_current_time() - start) * 1000 / iters);
+    }
+
+    std::sort(times.begin(), times.end());
+
+    fprintf(stdout, "{\"tag\":\"%s\",\"kernel\":\"%s\",\"case\":\"%s\",\"iters\":%d,\"us\":%.3f}\n", g_tag, kernel, name, iters, times[2]);
+    fflush(stdout);
+}
+
+static float frand()
+{
+    return rand() / (float)RAND_MAX;
+}
+
+// candidates clustered around a few faces like real detector output
+static void make_candidates(int count, std::vector<FaceObject>& faceobjects)
+{
+    faceobjects.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        const int face = i % 16;
+        FaceObject& obj = faceobjects[i];
+        obj.rect.x = (face % 4) * 150 + frand() * 8;
+        obj.rect.y = (face / 4) * 110 + frand() * 8;
+        obj.rect.width = 80 + frand() * 8;
+        obj.rect.height = 96 + frand() * 8;
+        obj.prob = frand();
+        obj.landmark_state = FaceObject::LANDMARK_FRESH;
+    }
+}
+
+static void bench_generate_proposals()
+{
+    ncnn::Mat ratios(1);
+    ratios[0] = 1.f;
+    ncnn::Mat scales(2);
+    scales[0] = 1.f;
+    scales[1] = 2.f;
+
+    // 640 input, stride 8 16 32
+    const int strides[3] = {8, 16, 32};
+    const int base_sizes[3] = {16, 64, 256};
+    const int input_size = 640;
+
+    for (int s = 0; s < 3; s++)
+    {
+        const int stride = strides[s];
+        const int fw = input_size / stride;
+        const int fh = input_size / stride;
+
+        ncnn::Mat anchors = generate_anchors(base_sizes[s], ratios, scales);
+
+        ncnn::Mat score(fw, fh, 2);
+        ncnn::Mat bbox(fw, fh, 8);
+        ncnn::Mat kps(fw, fh, 20);
+
+        // about 1% above threshold
+        for (int i = 0; i < (int)score.total(); i++)
+            score[i] = frand() < 0.01f ? 0.9f : 0.1f;
+        for (int i = 0; i < (int)bbox.total(); i++)
+            bbox[i] = frand() * 4;
+        for (int i = 0; i < (int)kps.total(); i++)
+            kps[i] = frand() * 4 - 2;
+
+        std::vector<FaceObject> proposals;
+
+        char name[64];
+        sprintf(name, "stride=%d,kps=1", stride);
+        run("generate_proposals", name, [&]() {
+            proposals.clear();
+            generate_proposals(anchors, stride, score, bbox, kps, 0.5f, proposals);
+        });
+
+        sprintf(name, "stride=%d,kps=0", stride);
+        run("generate_proposals", name, [&]() {
+            proposals.clear();
+            generate_proposals(anchors, stride, score, bbox, ncnn::Mat(), 0.5f, proposals);
+        });
+    }
+}
+
+static void bench_qsort_nms()
+{
+    const int counts[4] = {100, 1000, 5000, 20000};
+
+    for (int c = 0; c < 4; c++)
+    {
+        std::vector<FaceObject> candidates;
+        make_candidates(counts[c], candidates);
+
+        char name[64];
+        sprintf(name, "n=%d", counts[c]);
+
+        std::vector<FaceObject> faceobjects;
+        run("qsort_descent_inplace", name, [&]() {
+            faceobjects = candidates;
+            qsort_descent_inplace(faceobjects);
+        });
+
+        std::vector<FaceObject> sorted = candidates;
+        qsort_descent_inplace(sorted);
+
+        std::vector<int> picked;
+        std::vector<float> areas;
+        run("nms_sorted_bboxes", name, [&]() {
+            nms_sorted_bboxes(sorted, picked, areas, 0.45f);
+        });
+    }
+}
+
+static void bench_landmark_pre_post()
+{
+    const int sizes[3][2] = {{640, 480}, {1920, 1080}, {3840, 2160}};
+    const int face_counts[3] = {1, 4, 16};
+
+    for (int s = 0; s < 3; s++)
+    {
+        const int w = sizes[s][0];
+        const int h = sizes[s][1];
+
+        cv::Mat rgb(h, w, CV_8UC3);
+        for (size_t i = 0; i < rgb.total() * 3; i++)
+            rgb.data[i] = rand() % 256;
+
+        for (int f = 0; f < 3; f++)
+        {
+            const int face_count = face_counts[f];
+
+            std::vector<FaceObject> faces(face_count);
+            for (int i = 0; i < face_count; i++)
+            {
+                faces[i].rect.width = w / 8.f;
+                faces[i].rect.height = w / 8.f * 1.2f;
+                faces[i].rect.x = (i % 4) * w / 4.f + 10;
+                faces[i].rect.y = (i / 4) * h / 4.f + 10;
+            }
+
+            char name[64];
+            sprintf(name, "%dx%d,faces=%d", w, h, face_count);
+
+            cv::Mat crop;
+            double affine[6];
+            run("pre_process", name, [&]() {
+                for (int i = 0; i < face_count; i++)
+                    pre_process(rgb, 192, faces[i], crop, affine);
+            });
+        }
+    }
+
+    float output[212];
+    for (int i = 0; i < 212; i++)
+        output[i] = frand() * 2 - 1;
+
+    const double affine[6] = {0.8, 0, 12, 0, 0.8, 34};
+    cv::Point2f coord[106];
+    run("post_progress", "faces=1", [&]() {
+        post_progress(output, 192, affine, coord);
+    });
+}
+
+static void bench_camera_convert()
+{
+    const int sizes[3][2] = {{640, 480}, {1920, 1080}, {3840, 2160}};
+
+    for (int s = 0; s < 3; s++)
+    {
+        const int w = sizes[s][0];
+        const int h = sizes[s][1];
+
+        char name[64];
+        sprintf(name, "%dx%d", w, h);
+
+        // YUV_420_888 as most devices deliver it, padded rows and interleaved chroma with pixel stride 2
+        const int row_stride = (w + 63) / 64 * 64;
+        std::vector<unsigned char> y_plane(row_stride * h);
+        std::vector<unsigned char> uv_plane(row_stride * h / 2 + 1);
+        for (size_t i = 0; i < y_plane.size(); i++)
+            y_plane[i] = rand() % 256;
+        for (size_t i = 0; i < uv_plane.size(); i++)
+            uv_plane[i] = rand() % 256;
+
+        std::vector<unsigned char> nv21(w * h + w * h / 2);
+        run("yuv420888_to_nv21", name, [&]() {
+            yuv420888_to_nv21(y_plane.data(), uv_plane.data() + 1, uv_plane.data(), w, h, row_stride, row_stride, row_stride, 1, 2, 2, nv21.data());
+        });
+
+        std::vector<unsigned char> rgb(w * h * 3);
+        for (size_t i = 0; i < rgb.size(); i++)
+            rgb[i] = rand() % 256;
+
+        std::vector<unsigned char> rgba(w * h * 4);
+        run("rgb_to_rgba", name, [&]() {
+            rgb_to_rgba(rgb.data(), w, h, w * 3, rgba.data(), w * 4);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    g_tag = argc > 1 ? argv[1] : "";
+    g_filter = argc > 2 ? argv[2] : 0;
+
+    if (argc > 3 && simd_set_backend(atoi(argv[3])) != 0)
+    {
+        fprintf(stderr, "simd backend %s not available\n", argv[3]);
+        return -1;
+    }
+
+    fprintf(stderr, "simd backend %s\n", simd_kernels().name);
+
+    srand(0);
+
+    bench_generate_proposals();
+    bench_qsort_nms();
+    bench_landmark_pre_post();
+    bench_camera_convert();
+
+    return 0;
+}
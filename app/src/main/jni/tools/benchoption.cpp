@@ -0,0 +1,226 @@
+// benchmark every SCRFDNetConfig option combination on the host
+// prints latency and max output deviation against the fp32 reference
+//
+// usage: benchoption [modeltype] [imagepath] [loops]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+#include <cpu.h>
+#include <net.h>
+
+#include "scrfd.h"
+
+struct NetSpec
+{
+    const char* name;
+    std::string parampath;
+    std::string modelpath;
+    const char* input_name;
+    std::vector<std::string> output_names;
+    ncnn::Mat input;
+};
+
+static int run_net(const NetSpec& spec, const SCRFDNetConfig& config, int loops, std::vector<ncnn::Mat>& outputs, double& avg_ms)
+{
+    ncnn::Net net;
+    net.opt = ncnn::Option();
+    config.apply(net.opt);
+
+    if (net.load_param(spec.parampath.c_str()) != 0 || net.load_model(spec.modelpath.c_str()) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", spec.parampath.c_str());
+        return -1;
+    }
+
+    double total = 0;
+    for (int i = -1; i < loops; i++)
+    {
+        double start = ncnn::get_current_time();
+
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input(spec.input_name, spec.input);
+
+        outputs.resize(spec.output_names.size());
+        for (size_t j = 0; j < spec.output_names.size(); j++)
+        {
+            ex.extract(spec.output_names[j].c_str(), outputs[j]);
+        }
+
+        double end = ncnn::get_current_time();
+
+        // first run is warmup
+        if (i >= 0)
+            total += end - start;
+    }
+
+    avg_ms = total / loops;
+
+    return 0;
+}
+
+static float max_deviation(const std::vector<ncnn::Mat>& a, const std::vector<ncnn::Mat>& b)
+{
+    float maxdev = 0.f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        const ncnn::Mat& ma = a[i];
+        const ncnn::Mat& mb = b[i];
+
+        if (ma.w != mb.w || ma.h != mb.h || ma.c != mb.c)
+            return INFINITY;
+
+        for (int q = 0; q < ma.c; q++)
+        {
+            const float* pa = ma.channel(q);
+            const float* pb = mb.channel(q);
+            for (int k = 0; k < ma.w * ma.h; k++)
+            {
+                maxdev = std::max(maxdev, (float)fabs(pa[k] - pb[k]));
+            }
+        }
+    }
+
+    return maxdev;
+}
+
+static void bench_net(const NetSpec& spec, int loops)
+{
+    // fp32 reference, everything else left at default
+    SCRFDNetConfig ref_config;
+    ref_config.from_flags(SCRFDNetConfig::ALL_FLAGS & ~(SCRFDNetConfig::FP16_PACKED | SCRFDNetConfig::FP16_STORAGE | SCRFDNetConfig::FP16_ARITHMETIC));
+
+    std::vector<ncnn::Mat> ref_outputs;
+    double ref_ms = 0;
+    if (run_net(spec, ref_config, loops, ref_outputs, ref_ms) != 0)
+        return;
+
+    fprintf(stdout, "%-10s %5s %5s %5s %5s %5s %5s %5s %10s %12s\n", spec.name, "fp16p", "fp16s", "fp16a", "pack", "wino", "sgemm", "light", "avg_ms", "max_dev");
+
+    for (int flags = 0; flags <= SCRFDNetConfig::ALL_FLAGS; flags++)
+    {
+        SCRFDNetConfig config;
+        config.from_flags(flags);
+
+        std::vector<ncnn::Mat> outputs;
+        double avg_ms = 0;
+        if (run_net(spec, config, loops, outputs, avg_ms) != 0)
+            return;
+
+        float maxdev = max_deviation(ref_outputs, outputs);
+
+        fprintf(stdout, "%-10s %5d %5d %5d %5d %5d %5d %5d %10.3f %12.6f\n", spec.name,
+                config.use_fp16_packed, config.use_fp16_storage, config.use_fp16_arithmetic,
+                config.use_packing_layout, config.use_winograd_convolution, config.use_sgemm_convolution,
+                config.lightmode, avg_ms, maxdev);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* modeltype = argc > 1 ? argv[1] : "500m_kps";
+    const char* imagepath = argc > 2 ? argv[2] : 0;
+    int loops = argc > 3 ? atoi(argv[3]) : 8;
+
+    if (loops < 1)
+        loops = 1;
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+
+    cv::Mat rgb;
+    if (imagepath)
+    {
+        cv::Mat bgr = cv::imread(imagepath, 1);
+        if (bgr.empty())
+        {
+            fprintf(stderr, "cv::imread %s failed\n", imagepath);
+            return -1;
+        }
+
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    }
+    else
+    {
+        // synthetic 640x480 frame
+        rgb.create(480, 640, CV_8UC3);
+        srand(0);
+        for (size_t i = 0; i < rgb.total() * 3; i++)
+        {
+            rgb.data[i] = rand() % 256;
+        }
+    }
+
+    // same preprocessing as SCRFD::detect
+    NetSpec detector;
+    {
+        const int target_size = 120;
+
+        int w = rgb.cols;
+        int h = rgb.rows;
+        float scale = 1.f;
+        if (w > h)
+        {
+            scale = (float)target_size / w;
+            w = target_size;
+            h = h * scale;
+        }
+        else
+        {
+            scale = (float)target_size / h;
+            h = target_size;
+            w = w * scale;
+        }
+
+        ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, rgb.cols, rgb.rows, w, h);
+
+        int wpad = (w + 31) / 32 * 32 - w;
+        int hpad = (h + 31) / 32 * 32 - h;
+        ncnn::copy_make_border(in, detector.input, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+
+        const float mean_vals[3] = {127.5f, 127.5f, 127.5f};
+        const float norm_vals[3] = {1/128.f, 1/128.f, 1/128.f};
+        detector.input.substract_mean_normalize(mean_vals, norm_vals);
+
+        detector.name = "detector";
+        detector.parampath = std::string("scrfd_") + modeltype + "-opt2.param";
+        detector.modelpath = std::string("scrfd_") + modeltype + "-opt2.bin";
+        detector.input_name = "input.1";
+
+        const bool has_kps = strstr(modeltype, "_kps") != NULL;
+        const char* strides[3] = {"8", "16", "32"};
+        for (int i = 0; i < 3; i++)
+        {
+            detector.output_names.push_back(std::string("score_") + strides[i]);
+            detector.output_names.push_back(std::string("bbox_") + strides[i]);
+            if (has_kps)
+                detector.output_names.push_back(std::string("kps_") + strides[i]);
+        }
+    }
+
+    NetSpec landmark;
+    {
+        landmark.name = "landmark";
+        landmark.parampath = "2d106det_change.param";
+        landmark.modelpath = "2d106det_change.bin";
+        landmark.input_name = "data";
+        landmark.output_names.push_back("fc1");
+        landmark.input = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, rgb.cols, rgb.rows, 192, 192);
+    }
+
+    bench_net(detector, loops);
+    bench_net(landmark, loops);
+
+    return 0;
+}
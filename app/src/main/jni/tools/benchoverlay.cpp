@@ -0,0 +1,95 @@
+// SCRFD::draw against SCRFD::draw_overlay on synthetic faces with 106 landmarks
+//
+// usage: benchoverlay [modeltype] [maxfaces] [loops]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <benchmark.h>
+
+#include "scrfd.h"
+
+static void make_faces(int face_count, int width, int height, FrameResult& result)
+{
+    result.clear();
+    result.faceobjects.resize(face_count);
+    result.landmarks.resize(face_count * 106);
+
+    srand(face_count);
+    for (int i = 0; i < face_count; i++)
+    {
+        FaceObject& obj = result.faceobjects[i];
+        obj.rect.width = 60 + rand() % 60;
+        obj.rect.height = obj.rect.width * 1.2f;
+        obj.rect.x = rand() % (int)(width - obj.rect.width);
+        obj.rect.y = rand() % (int)(height - obj.rect.height);
+        obj.prob = 0.5f + (rand() % 500) / 1000.f;
+        obj.landmark_state = FaceObject::LANDMARK_FRESH;
+
+        for (int k = 0; k < 5; k++)
+        {
+            obj.landmark[k].x = obj.rect.x + rand() % (int)obj.rect.width;
+            obj.landmark[k].y = obj.rect.y + rand() % (int)obj.rect.height;
+        }
+
+        cv::Point2f* points = result.face_landmarks(i);
+        for (int k = 0; k < 106; k++)
+        {
+            points[k].x = obj.rect.x + rand() % (int)obj.rect.width;
+            points[k].y = obj.rect.y + rand() % (int)obj.rect.height;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* modeltype = argc > 1 ? argv[1] : "500m_kps";
+    int maxfaces = argc > 2 ? atoi(argv[2]) : 16;
+    int loops = argc > 3 ? atoi(argv[3]) : 100;
+
+    if (loops < 1)
+        loops = 1;
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    cv::Mat rgb(480, 640, CV_8UC3, cv::Scalar(64, 64, 64));
+    cv::Mat rgba(480, 640, CV_8UC4, cv::Scalar(64, 64, 64, 255));
+
+    fprintf(stdout, "%6s %12s %12s %12s %10s\n", "faces", "draw_ms", "overlay_ms", "rgba_ms", "speedup");
+
+    for (int face_count = 1; face_count <= maxfaces; face_count *= 2)
+    {
+        FrameResult result;
+        make_faces(face_count, rgb.cols, rgb.rows, result);
+
+        double t0 = ncnn::get_current_time();
+        for (int i = 0; i < loops; i++)
+        {
+            scrfd.draw(rgb, result);
+        }
+        double t1 = ncnn::get_current_time();
+        for (int i = 0; i < loops; i++)
+        {
+            scrfd.draw_overlay(rgb, result);
+        }
+        double t2 = ncnn::get_current_time();
+        for (int i = 0; i < loops; i++)
+        {
+            scrfd.draw_overlay(rgba, result);
+        }
+        double t3 = ncnn::get_current_time();
+
+        double draw_ms = (t1 - t0) / loops;
+        double overlay_ms = (t2 - t1) / loops;
+        double rgba_ms = (t3 - t2) / loops;
+
+        fprintf(stdout, "%6d %12.4f %12.4f %12.4f %10.2f\n", face_count, draw_ms, overlay_ms, rgba_ms, draw_ms / overlay_ms);
+    }
+
+    return 0;
+}
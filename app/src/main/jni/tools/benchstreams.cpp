@@ -0,0 +1,97 @@
+// throughput of SCRFD::detect with 1..N concurrent streams sharing one loaded SCRFD
+// each stream owns a SCRFDContext and runs single-threaded inference
+//
+// usage: benchstreams [modeltype] [imagepath] [maxstreams] [frames]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+#include <cpu.h>
+
+#include "scrfd.h"
+
+static void run_stream(const SCRFD* scrfd, const cv::Mat* rgb, int frames, int* face_count)
+{
+    SCRFDContext ctx;
+    ctx.detector_threads = 1;
+    ctx.landmark_threads = 1;
+
+    FrameResult result;
+    for (int i = 0; i < frames; i++)
+    {
+        scrfd->detect(ctx, *rgb, result);
+
+        *face_count = result.face_count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* modeltype = argc > 1 ? argv[1] : "500m_kps";
+    const char* imagepath = argc > 2 ? argv[2] : 0;
+    int maxstreams = argc > 3 ? atoi(argv[3]) : ncnn::get_cpu_count();
+    int frames = argc > 4 ? atoi(argv[4]) : 100;
+
+    cv::Mat rgb;
+    if (imagepath)
+    {
+        cv::Mat bgr = cv::imread(imagepath, 1);
+        if (bgr.empty())
+        {
+            fprintf(stderr, "cv::imread %s failed\n", imagepath);
+            return -1;
+        }
+
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    }
+    else
+    {
+        rgb.create(480, 640, CV_8UC3);
+        srand(0);
+        for (size_t i = 0; i < rgb.total() * 3; i++)
+        {
+            rgb.data[i] = rand() % 256;
+        }
+    }
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    fprintf(stdout, "%8s %10s %12s %12s %6s\n", "streams", "frames", "total_ms", "frames/s", "faces");
+
+    for (int streams = 1; streams <= maxstreams; streams++)
+    {
+        std::vector<std::thread> threads;
+        std::vector<int> face_counts(streams, 0);
+
+        double start = ncnn::get_current_time();
+
+        for (int i = 0; i < streams; i++)
+        {
+            threads.push_back(std::thread(run_stream, &scrfd, &rgb, frames, &face_counts[i]));
+        }
+
+        for (int i = 0; i < streams; i++)
+        {
+            threads[i].join();
+        }
+
+        double end = ncnn::get_current_time();
+
+        double total_ms = end - start;
+        int total_frames = streams * frames;
+
+        fprintf(stdout, "%8d %10d %12.2f %12.2f %6d\n", streams, total_frames, total_ms, total_frames * 1000.0 / total_ms, face_counts[0]);
+    }
+
+    return 0;
+}
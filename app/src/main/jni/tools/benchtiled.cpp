@@ -0,0 +1,96 @@
+// latency and face count of TiledDetector against one SCRFD::detect call on large frames
+// the tiled pass runs with 1..N pool workers
+//
+// usage: benchtiled <modeltype> <imagepath> [scale] [tile_size] [overlap] [maxworkers] [loops]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+#include <cpu.h>
+
+#include "scrfd.h"
+#include "tiledetect.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <modeltype> <imagepath> [scale] [tile_size] [overlap] [maxworkers] [loops]\n", argv[0]);
+        return -1;
+    }
+
+    const char* modeltype = argv[1];
+    const char* imagepath = argv[2];
+    float scale = argc > 3 ? (float)atof(argv[3]) : 1.f;
+    int tile_size = argc > 4 ? atoi(argv[4]) : 640;
+    int overlap = argc > 5 ? atoi(argv[5]) : 96;
+    int maxworkers = argc > 6 ? atoi(argv[6]) : ncnn::get_cpu_count();
+    int loops = argc > 7 ? atoi(argv[7]) : 10;
+
+    cv::Mat bgr = cv::imread(imagepath, 1);
+    if (bgr.empty())
+    {
+        fprintf(stderr, "cv::imread %s failed\n", imagepath);
+        return -1;
+    }
+
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    SCRFDContext ctx;
+    ctx.detector_threads = 1;
+    ctx.landmark_threads = 1;
+
+    FrameResult result;
+
+    fprintf(stdout, "image %dx%d  scale %.2f  tile %d  overlap %d\n", rgb.cols, rgb.rows, scale, tile_size, overlap);
+    fprintf(stdout, "%8s %8s %12s %6s\n", "workers", "tiles", "ms", "faces");
+
+    {
+        scrfd.detect(ctx, rgb, result);
+
+        double t0 = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            scrfd.detect(ctx, rgb, result);
+        }
+        double t1 = ncnn::get_current_time();
+
+        fprintf(stdout, "%8s %8d %12.2f %6d\n", "detect", 1, (t1 - t0) / loops, result.face_count());
+    }
+
+    for (int workers = 1; workers <= maxworkers; workers++)
+    {
+        TiledDetector tiled(scrfd, workers);
+        tiled.scale = scale;
+        tiled.tile_size = tile_size;
+        tiled.overlap = overlap;
+
+        std::vector<cv::Rect> tiles;
+        tiled.layout(rgb.cols, rgb.rows, tiles);
+
+        tiled.detect(ctx, rgb, result);
+
+        double t0 = ncnn::get_current_time();
+        for (int l = 0; l < loops; l++)
+        {
+            tiled.detect(ctx, rgb, result);
+        }
+        double t1 = ncnn::get_current_time();
+
+        fprintf(stdout, "%8d %8d %12.2f %6d\n", workers, (int)tiles.size(), (t1 - t0) / loops, result.face_count());
+    }
+
+    return 0;
+}
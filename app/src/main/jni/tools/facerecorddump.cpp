@@ -0,0 +1,61 @@
+// print the records of a facerecord journal
+//
+// usage: facerecorddump <journal> [first] [count]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "facerecord.h"
+
+static const char* landmark_state_name(int state)
+{
+    if (state == FaceObject::LANDMARK_DEFERRED)
+        return "deferred";
+    if (state == FaceObject::LANDMARK_FALLBACK)
+        return "fallback";
+
+    return "fresh";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <journal> [first] [count]\n", argv[0]);
+        return -1;
+    }
+
+    FaceRecordReader reader;
+    if (reader.open(argv[1]) != 0)
+    {
+        fprintf(stderr, "open %s failed\n", argv[1]);
+        return -1;
+    }
+
+    const int frame_count = reader.frame_count();
+    int first = argc > 2 ? atoi(argv[2]) : 0;
+    int count = argc > 3 ? atoi(argv[3]) : frame_count;
+
+    fprintf(stderr, "%d frames\n", frame_count);
+
+    FaceRecordFrame frame;
+    for (int i = first; i < first + count && i < frame_count; i++)
+    {
+        reader.read(i, frame);
+
+        const FrameResult& result = frame.result;
+
+        fprintf(stdout, "frame %llu  t %lld us  faces %d%s\n", (unsigned long long)frame.frame_id, (long long)frame.timestamp_us, result.face_count(), result.has_landmarks() ? "  +landmarks" : "");
+
+        for (int j = 0; j < result.face_count(); j++)
+        {
+            const FaceObject& obj = result.faceobjects[j];
+            fprintf(stdout, "  %.4f  %.1f %.1f %.1f %.1f", obj.prob, obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
+            if (result.has_landmarks())
+                fprintf(stdout, "  %s", landmark_state_name(obj.landmark_state));
+            fprintf(stdout, "\n");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+// compare every model in refdir with its ncnnoptimize output in optdir
+// reports file size, load time, inference latency and the max output deviation of each net
+// built by the model_report target after optimize_models, see CMakeLists.txt
+//
+// usage: modelcompare <refdir> <optdir> [loops] [tolerance]
+//   tolerance = max abs output deviation allowed, fp16 weights usually stay well under 0.01
+// exits non-zero when a net fails to load or deviates past tolerance
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark.h>
+#include <cpu.h>
+#include <net.h>
+
+struct ModelSpec
+{
+    const char* name;
+    const char* input_name;
+    int input_size;
+    // scrfd input is normalized by the caller, 2d106det takes raw pixels
+    bool normalize;
+    std::vector<std::string> output_names;
+};
+
+struct ModelRun
+{
+    size_t bytes;
+    double load_ms;
+    double avg_ms;
+    std::vector<ncnn::Mat> outputs;
+};
+
+static size_t file_size(const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return 0;
+
+    return (size_t)st.st_size;
+}
+
+static bool file_exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static int run_model(const std::string& dir, const ModelSpec& spec, const ncnn::Mat& in, int loops, ModelRun& run)
+{
+    const std::string parampath = dir + "/" + spec.name + ".param";
+    const std::string modelpath = dir + "/" + spec.name + ".bin";
+
+    run.bytes = file_size(parampath) + file_size(modelpath);
+
+    ncnn::Net net;
+
+    double t0 = ncnn::get_current_time();
+
+    if (net.load_param(parampath.c_str()) != 0 || net.load_model(modelpath.c_str()) != 0)
+    {
+        fprintf(stderr, "load %s failed\n", parampath.c_str());
+        return -1;
+    }
+
+    run.load_ms = ncnn::get_current_time() - t0;
+
+    double total = 0;
+    for (int i = -1; i < loops; i++)
+    {
+        double start = ncnn::get_current_time();
+
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input(spec.input_name, in);
+
+        run.outputs.resize(spec.output_names.size());
+        for (size_t j = 0; j < spec.output_names.size(); j++)
+        {
+            ex.extract(spec.output_names[j].c_str(), run.outputs[j]);
+        }
+
+        double end = ncnn::get_current_time();
+
+        // first run is warmup
+        if (i >= 0)
+            total += end - start;
+    }
+
+    run.avg_ms = total / loops;
+
+    return 0;
+}
+
+static float max_deviation(const std::vector<ncnn::Mat>& a, const std::vector<ncnn::Mat>& b)
+{
+    float maxdev = 0.f;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        const ncnn::Mat& ma = a[i];
+        const ncnn::Mat& mb = b[i];
+
+        if (ma.w != mb.w || ma.h != mb.h || ma.c != mb.c)
+            return INFINITY;
+
+        for (int q = 0; q < ma.c; q++)
+        {
+            const float* pa = ma.channel(q);
+            const float* pb = mb.channel(q);
+            for (int k = 0; k < ma.w * ma.h; k++)
+            {
+                maxdev = std::max(maxdev, (float)fabs(pa[k] - pb[k]));
+            }
+        }
+    }
+
+    return maxdev;
+}
+
+static void add_scrfd_spec(const char* name, bool kps, std::vector<ModelSpec>& specs)
+{
+    ModelSpec spec;
+    spec.name = name;
+    spec.input_name = "input.1";
+    spec.input_size = 320;
+    spec.normalize = true;
+
+    static const int strides[3] = {8, 16, 32};
+    for (int i = 0; i < 3; i++)
+    {
+        char blobname[32];
+        sprintf(blobname, "score_%d", strides[i]);
+        spec.output_names.push_back(blobname);
+        sprintf(blobname, "bbox_%d", strides[i]);
+        spec.output_names.push_back(blobname);
+        if (kps)
+        {
+            sprintf(blobname, "kps_%d", strides[i]);
+            spec.output_names.push_back(blobname);
+        }
+    }
+
+    specs.push_back(spec);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <refdir> <optdir> [loops] [tolerance]\n", argv[0]);
+        return -1;
+    }
+
+    const std::string refdir = argv[1];
+    const std::string optdir = argv[2];
+    int loops = argc > 3 ? atoi(argv[3]) : 8;
+    float tolerance = argc > 4 ? (float)atof(argv[4]) : 0.01f;
+
+    if (loops < 1)
+        loops = 1;
+
+    ncnn::set_cpu_powersave(2);
+    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+
+    std::vector<ModelSpec> specs;
+    add_scrfd_spec("scrfd_500m-opt2", false, specs);
+    add_scrfd_spec("scrfd_500m_kps-opt2", true, specs);
+    add_scrfd_spec("scrfd_1g-opt2", false, specs);
+    add_scrfd_spec("scrfd_2.5g-opt2", false, specs);
+    add_scrfd_spec("scrfd_2.5g_kps-opt2", true, specs);
+    add_scrfd_spec("scrfd_10g-opt2", false, specs);
+    add_scrfd_spec("scrfd_10g_kps-opt2", true, specs);
+    add_scrfd_spec("scrfd_34g-opt2", false, specs);
+    {
+        ModelSpec spec;
+        spec.name = "2d106det_change";
+        spec.input_name = "data";
+        spec.input_size = 192;
+        spec.normalize = false;
+        spec.output_names.push_back("fc1");
+        specs.push_back(spec);
+    }
+
+    fprintf(stdout, "%-22s %10s %10s %9s %9s %9s %9s %10s\n", "model", "ref_kb", "opt_kb", "ref_load", "opt_load", "ref_ms", "opt_ms", "max_dev");
+
+    int failed = 0;
+    int compared = 0;
+
+    for (size_t m = 0; m < specs.size(); m++)
+    {
+        const ModelSpec& spec = specs[m];
+
+        if (!file_exists(refdir + "/" + spec.name + ".bin") || !file_exists(optdir + "/" + spec.name + ".bin"))
+        {
+            fprintf(stdout, "%-22s skipped, weights missing\n", spec.name);
+            continue;
+        }
+
+        // same pseudo random pixels for both runs
+        ncnn::Mat in(spec.input_size, spec.input_size, 3);
+        srand(0);
+        for (int q = 0; q < 3; q++)
+        {
+            float* ptr = in.channel(q);
+            for (int i = 0; i < spec.input_size * spec.input_size; i++)
+            {
+                const float v = (float)(rand() % 256);
+                ptr[i] = spec.normalize ? (v - 127.5f) / 128.f : v;
+            }
+        }
+
+        ModelRun ref;
+        ModelRun opt;
+        if (run_model(refdir, spec, in, loops, ref) != 0 || run_model(optdir, spec, in, loops, opt) != 0)
+        {
+            failed++;
+            continue;
+        }
+
+        const float maxdev = max_deviation(ref.outputs, opt.outputs);
+        const bool pass = maxdev <= tolerance;
+
+        fprintf(stdout, "%-22s %10.1f %10.1f %9.2f %9.2f %9.3f %9.3f %10.6f %s\n", spec.name,
+                ref.bytes / 1024.0, opt.bytes / 1024.0, ref.load_ms, opt.load_ms, ref.avg_ms, opt.avg_ms, maxdev, pass ? "ok" : "FAIL");
+
+        compared++;
+        if (!pass)
+            failed++;
+    }
+
+    fprintf(stdout, "compared %d  failed %d  tolerance %f\n", compared, failed, tolerance);
+
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,212 @@
+// run SCRFD::detect over every image below a directory
+// images are decoded and detected on a work-stealing pool, results stream to stdout as they finish
+//
+// usage: scrfdbatch <modeltype> <imagedir> [workers] [threads]
+//   workers = number of pool workers, each with its own SCRFDContext
+//   threads = ncnn threads per worker
+//   eg. "8 1" runs eight single-threaded engines, "2 4" runs two engines with four threads each
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+//
+// output, one line per image:
+//   <path> <ms> <face count> [<x> <y> <w> <h> <prob>]...
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+#include <cpu.h>
+
+#include "metrics.h"
+#include "scrfd.h"
+#include "threadpool.h"
+#include "trace.h"
+
+static bool is_image_file(const char* name)
+{
+    const char* ext = strrchr(name, '.');
+    if (!ext)
+        return false;
+
+    static const char* exts[] = {".jpg", ".jpeg", ".png", ".bmp", ".JPG", ".JPEG", ".PNG", ".BMP"};
+    for (int i = 0; i < 8; i++)
+    {
+        if (strcmp(ext, exts[i]) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void list_images(const std::string& dirpath, std::vector<std::string>& paths)
+{
+    DIR* dir = opendir(dirpath.c_str());
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        std::string path = dirpath + "/" + entry->d_name;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            list_images(path, paths);
+        }
+        else if (S_ISREG(st.st_mode) && is_image_file(entry->d_name))
+        {
+            paths.push_back(path);
+        }
+    }
+
+    closedir(dir);
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <modeltype> <imagedir> [workers] [threads]\n", argv[0]);
+        return -1;
+    }
+
+    const char* modeltype = argv[1];
+    const char* imagedir = argv[2];
+    int workers = argc > 3 ? atoi(argv[3]) : ncnn::get_cpu_count();
+    int threads = argc > 4 ? atoi(argv[4]) : 1;
+
+    if (workers < 1)
+        workers = 1;
+
+    std::vector<std::string> paths;
+    list_images(imagedir, paths);
+    std::sort(paths.begin(), paths.end());
+
+    if (paths.empty())
+    {
+        fprintf(stderr, "no image found in %s\n", imagedir);
+        return -1;
+    }
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    std::vector<SCRFDContext*> contexts;
+    std::vector<FrameResult> results(workers);
+    for (int i = 0; i < workers; i++)
+    {
+        SCRFDContext* ctx = new SCRFDContext;
+        ctx->detector_threads = threads;
+        ctx->landmark_threads = threads;
+        contexts.push_back(ctx);
+    }
+
+    std::vector<double> latencies(paths.size(), 0.0);
+    std::mutex output_lock;
+    int failed = 0;
+
+    double start = ncnn::get_current_time();
+
+    {
+        WorkStealingPool pool(workers);
+
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            pool.submit([&, i](int worker) {
+                scrfd.bind_thread();
+
+                double t0 = ncnn::get_current_time();
+
+                cv::Mat bgr = cv::imread(paths[i], 1);
+                if (bgr.empty())
+                {
+                    std::unique_lock<std::mutex> g(output_lock);
+                    fprintf(stderr, "cv::imread %s failed\n", paths[i].c_str());
+                    failed++;
+                    return;
+                }
+
+                cv::Mat rgb;
+                cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+                FrameResult& result = results[worker];
+                scrfd.detect(*contexts[worker], rgb, result);
+                const std::vector<FaceObject>& faceobjects = result.faceobjects;
+
+                double t1 = ncnn::get_current_time();
+                latencies[i] = t1 - t0;
+
+                std::unique_lock<std::mutex> g(output_lock);
+                fprintf(stdout, "%s %.2f %d", paths[i].c_str(), t1 - t0, (int)faceobjects.size());
+                for (size_t j = 0; j < faceobjects.size(); j++)
+                {
+                    const FaceObject& obj = faceobjects[j];
+                    fprintf(stdout, " %.1f %.1f %.1f %.1f %.4f", obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height, obj.prob);
+                }
+                fprintf(stdout, "\n");
+                fflush(stdout);
+            });
+        }
+
+        pool.wait();
+    }
+
+    double end = ncnn::get_current_time();
+
+    for (int i = 0; i < workers; i++)
+    {
+        delete contexts[i];
+    }
+
+    std::vector<double> sorted;
+    for (size_t i = 0; i < latencies.size(); i++)
+    {
+        if (latencies[i] > 0.0)
+            sorted.push_back(latencies[i]);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    const double total_ms = end - start;
+    fprintf(stderr, "images %d  failed %d  workers %d  threads %d\n", (int)paths.size(), failed, workers, threads);
+    fprintf(stderr, "total %.2f ms  %.2f images/s\n", total_ms, sorted.size() * 1000.0 / total_ms);
+    fprintf(stderr, "latency p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n", percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back());
+
+    // per-stage breakdown across all workers
+    MetricsSnapshot snapshot;
+    metrics_snapshot(snapshot);
+    metrics_print(snapshot, stderr);
+
+#if SCRFD_TRACE
+    if (trace_dump("scrfdbatch.trace.json") == 0)
+        fprintf(stderr, "trace written to scrfdbatch.trace.json\n");
+#endif // SCRFD_TRACE
+
+    return 0;
+}
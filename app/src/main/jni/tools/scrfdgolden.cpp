@@ -0,0 +1,518 @@
+// golden-output regression check for every model variant and the landmark net
+//
+// usage: scrfdgolden record <imagedir> <goldendir>
+//        scrfdgolden check <imagedir> <goldendir> [tolerance]
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+//
+// record runs every available variant over the images below imagedir and writes goldendir/golden_<modeltype>.txt
+// check runs them again and compares against the golden files
+//   faces are paired at iou 0.5, deviations are the max abs difference in pixels of
+//   box corners, 5 keypoints and 106 landmarks
+//   an unpaired face fails unless its score is within 0.02 of the threshold
+//   exit code 1 when any deviation is above tolerance, default 1 pixel
+//
+// an optional annotation <image>.txt next to an image, one "x y w h" line per face,
+// adds recall and precision at iou 0.5 for golden and current results
+// inference runs single-threaded so outputs are reproducible
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include <benchmark.h>
+
+#include "scrfd.h"
+
+static const char* modeltypes[] =
+{
+    "500m",
+    "500m_kps",
+    "1g",
+    "2.5g",
+    "2.5g_kps",
+    "10g",
+    "10g_kps",
+    "34g"
+};
+
+static const float prob_threshold = 0.5f;
+
+struct GoldenImage
+{
+    std::string path; // relative to imagedir
+    FrameResult result;
+};
+
+struct GoldenSet
+{
+    double avg_ms;
+    std::vector<GoldenImage> images;
+};
+
+static bool is_image_file(const char* name)
+{
+    const char* ext = strrchr(name, '.');
+    if (!ext)
+        return false;
+
+    static const char* exts[] = {".jpg", ".jpeg", ".png", ".bmp", ".JPG", ".JPEG", ".PNG", ".BMP"};
+    for (int i = 0; i < 8; i++)
+    {
+        if (strcmp(ext, exts[i]) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void list_images(const std::string& dirpath, const std::string& relpath, std::vector<std::string>& paths)
+{
+    DIR* dir = opendir(dirpath.c_str());
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        std::string path = dirpath + "/" + entry->d_name;
+        std::string rel = relpath.empty() ? entry->d_name : relpath + "/" + entry->d_name;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            list_images(path, rel, paths);
+        }
+        else if (S_ISREG(st.st_mode) && is_image_file(entry->d_name))
+        {
+            paths.push_back(rel);
+        }
+    }
+
+    closedir(dir);
+}
+
+static bool file_exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static float iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b)
+{
+    float inter = (a & b).area();
+    float uni = a.area() + b.area() - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+// greedy pairing at iou >= 0.5, match[i] = index in b or -1
+static void match_faces(const std::vector<cv::Rect_<float> >& a, const std::vector<cv::Rect_<float> >& b, std::vector<int>& match)
+{
+    match.assign(a.size(), -1);
+    std::vector<bool> used(b.size(), false);
+
+    for (;;)
+    {
+        int best_i = -1;
+        int best_j = -1;
+        float best = 0.5f;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (match[i] != -1)
+                continue;
+
+            for (size_t j = 0; j < b.size(); j++)
+            {
+                if (used[j])
+                    continue;
+
+                float v = iou(a[i], b[j]);
+                if (v >= best)
+                {
+                    best = v;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+
+        if (best_i == -1)
+            break;
+
+        match[best_i] = best_j;
+        used[best_j] = true;
+    }
+}
+
+static void face_rects(const FrameResult& result, std::vector<cv::Rect_<float> >& rects)
+{
+    rects.resize(result.face_count());
+    for (int i = 0; i < result.face_count(); i++)
+        rects[i] = result.faceobjects[i].rect;
+}
+
+static bool load_annotation(const std::string& imagepath, std::vector<cv::Rect_<float> >& rects)
+{
+    rects.clear();
+
+    FILE* fp = fopen((imagepath + ".txt").c_str(), "rb");
+    if (!fp)
+        return false;
+
+    float x, y, w, h;
+    while (fscanf(fp, "%f %f %f %f", &x, &y, &w, &h) == 4)
+    {
+        rects.push_back(cv::Rect_<float>(x, y, w, h));
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static int run_model(const char* modeltype, const std::string& imagedir, const std::vector<std::string>& paths, GoldenSet& set)
+{
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    SCRFDContext ctx;
+    ctx.detector_threads = 1;
+    ctx.landmark_threads = 1;
+
+    set.images.resize(paths.size());
+
+    double total_ms = 0;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        cv::Mat bgr = cv::imread(imagedir + "/" + paths[i], 1);
+        if (bgr.empty())
+        {
+            fprintf(stderr, "cv::imread %s failed\n", paths[i].c_str());
+            return -1;
+        }
+
+        cv::Mat rgb;
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+        GoldenImage& image = set.images[i];
+        image.path = paths[i];
+
+        // warmup on the first image
+        if (i == 0)
+            scrfd.detect(ctx, rgb, image.result, prob_threshold);
+
+        double start = ncnn::get_current_time();
+        scrfd.detect(ctx, rgb, image.result, prob_threshold);
+        total_ms += ncnn::get_current_time() - start;
+    }
+
+    set.avg_ms = paths.empty() ? 0 : total_ms / paths.size();
+
+    return 0;
+}
+
+static int save_golden(const std::string& path, const GoldenSet& set)
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "ms %.4f\n", set.avg_ms);
+    for (size_t i = 0; i < set.images.size(); i++)
+    {
+        const FrameResult& result = set.images[i].result;
+
+        fprintf(fp, "image %d %d %s\n", result.face_count(), result.has_landmarks() ? 1 : 0, set.images[i].path.c_str());
+        for (int j = 0; j < result.face_count(); j++)
+        {
+            const FaceObject& obj = result.faceobjects[j];
+            fprintf(fp, "%.4f %.4f %.4f %.4f %.6f", obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height, obj.prob);
+            for (int k = 0; k < 5; k++)
+                fprintf(fp, " %.4f %.4f", obj.landmark[k].x, obj.landmark[k].y);
+            fprintf(fp, "\n");
+
+            if (result.has_landmarks())
+            {
+                const cv::Point2f* points = result.face_landmarks(j);
+                for (int k = 0; k < 106; k++)
+                    fprintf(fp, "%.4f %.4f%s", points[k].x, points[k].y, k == 105 ? "\n" : " ");
+            }
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static int load_golden(const std::string& path, GoldenSet& set)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return -1;
+
+    set.images.clear();
+    if (fscanf(fp, "ms %lf\n", &set.avg_ms) != 1)
+    {
+        fclose(fp);
+        return -1;
+    }
+
+    int face_count = 0;
+    int has_landmarks = 0;
+    char line[4096];
+    while (fscanf(fp, "image %d %d ", &face_count, &has_landmarks) == 2 && fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+
+        GoldenImage image;
+        image.path = line;
+
+        FrameResult& result = image.result;
+        result.faceobjects.resize(face_count);
+        result.landmarks.resize(has_landmarks ? face_count * 106 : 0);
+        for (int j = 0; j < face_count; j++)
+        {
+            FaceObject& obj = result.faceobjects[j];
+            fscanf(fp, "%f %f %f %f %f", &obj.rect.x, &obj.rect.y, &obj.rect.width, &obj.rect.height, &obj.prob);
+            for (int k = 0; k < 5; k++)
+                fscanf(fp, "%f %f", &obj.landmark[k].x, &obj.landmark[k].y);
+            obj.landmark_state = FaceObject::LANDMARK_FRESH;
+
+            if (has_landmarks)
+            {
+                cv::Point2f* points = result.face_landmarks(j);
+                for (int k = 0; k < 106; k++)
+                    fscanf(fp, "%f %f", &points[k].x, &points[k].y);
+            }
+        }
+        fscanf(fp, "\n");
+
+        set.images.push_back(image);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+struct Accuracy
+{
+    int annotated;
+    int matched;
+    int detected;
+
+    Accuracy() : annotated(0), matched(0), detected(0) {}
+
+    void add(const std::vector<cv::Rect_<float> >& truth, const FrameResult& result)
+    {
+        std::vector<cv::Rect_<float> > rects;
+        face_rects(result, rects);
+
+        std::vector<int> match;
+        match_faces(truth, rects, match);
+
+        annotated += truth.size();
+        detected += rects.size();
+        for (size_t i = 0; i < match.size(); i++)
+        {
+            if (match[i] != -1)
+                matched++;
+        }
+    }
+
+    float recall() const { return annotated ? (float)matched / annotated : 0.f; }
+    float precision() const { return detected ? (float)matched / detected : 0.f; }
+};
+
+static float max_abs(float a, float b, float c)
+{
+    return std::max(a, (float)fabs(b - c));
+}
+
+// 0 pass, 1 fail
+static int check_model(const char* modeltype, const std::string& imagedir, const GoldenSet& golden, const GoldenSet& current, float tolerance)
+{
+    float box_dev = 0.f;
+    float kps_dev = 0.f;
+    float lmk_dev = 0.f;
+    int faces = 0;
+    int unpaired = 0;
+    int unpaired_fail = 0;
+
+    Accuracy golden_acc;
+    Accuracy current_acc;
+    bool annotated = false;
+
+    for (size_t i = 0; i < golden.images.size(); i++)
+    {
+        const FrameResult& g = golden.images[i].result;
+        const FrameResult& c = current.images[i].result;
+
+        std::vector<cv::Rect_<float> > grects;
+        std::vector<cv::Rect_<float> > crects;
+        face_rects(g, grects);
+        face_rects(c, crects);
+
+        std::vector<int> match;
+        match_faces(grects, crects, match);
+
+        std::vector<bool> cpaired(crects.size(), false);
+        for (size_t j = 0; j < match.size(); j++)
+        {
+            const FaceObject& gobj = g.faceobjects[j];
+
+            if (match[j] == -1)
+            {
+                unpaired++;
+                if (fabs(gobj.prob - prob_threshold) > 0.02f)
+                    unpaired_fail++;
+                continue;
+            }
+
+            const FaceObject& cobj = c.faceobjects[match[j]];
+            cpaired[match[j]] = true;
+            faces++;
+
+            box_dev = max_abs(box_dev, gobj.rect.x, cobj.rect.x);
+            box_dev = max_abs(box_dev, gobj.rect.y, cobj.rect.y);
+            box_dev = max_abs(box_dev, gobj.rect.x + gobj.rect.width, cobj.rect.x + cobj.rect.width);
+            box_dev = max_abs(box_dev, gobj.rect.y + gobj.rect.height, cobj.rect.y + cobj.rect.height);
+
+            for (int k = 0; k < 5; k++)
+            {
+                kps_dev = max_abs(kps_dev, gobj.landmark[k].x, cobj.landmark[k].x);
+                kps_dev = max_abs(kps_dev, gobj.landmark[k].y, cobj.landmark[k].y);
+            }
+
+            if (g.has_landmarks() && c.has_landmarks())
+            {
+                const cv::Point2f* gp = g.face_landmarks(j);
+                const cv::Point2f* cp = c.face_landmarks(match[j]);
+                for (int k = 0; k < 106; k++)
+                {
+                    lmk_dev = max_abs(lmk_dev, gp[k].x, cp[k].x);
+                    lmk_dev = max_abs(lmk_dev, gp[k].y, cp[k].y);
+                }
+            }
+        }
+
+        for (size_t j = 0; j < crects.size(); j++)
+        {
+            if (cpaired[j])
+                continue;
+
+            unpaired++;
+            if (fabs(c.faceobjects[j].prob - prob_threshold) > 0.02f)
+                unpaired_fail++;
+        }
+
+        std::vector<cv::Rect_<float> > truth;
+        if (load_annotation(imagedir + "/" + golden.images[i].path, truth))
+        {
+            annotated = true;
+            golden_acc.add(truth, g);
+            current_acc.add(truth, c);
+        }
+    }
+
+    const bool fail = unpaired_fail > 0 || box_dev > tolerance || kps_dev > tolerance || lmk_dev > tolerance;
+
+    fprintf(stdout, "%-10s %6d %6d %8d %9.4f %9.4f %9.4f", modeltype, (int)golden.images.size(), faces, unpaired, box_dev, kps_dev, lmk_dev);
+    if (annotated)
+        fprintf(stdout, " %6.3f/%-6.3f %6.3f/%-6.3f", golden_acc.recall(), current_acc.recall(), golden_acc.precision(), current_acc.precision());
+    else
+        fprintf(stdout, " %13s %13s", "-", "-");
+    fprintf(stdout, " %8.2f/%-8.2f %s\n", golden.avg_ms, current.avg_ms, fail ? "FAIL" : "ok");
+
+    return fail ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4 || (strcmp(argv[1], "record") != 0 && strcmp(argv[1], "check") != 0))
+    {
+        fprintf(stderr, "Usage: %s record <imagedir> <goldendir>\n", argv[0]);
+        fprintf(stderr, "       %s check <imagedir> <goldendir> [tolerance]\n", argv[0]);
+        return -1;
+    }
+
+    const bool record = strcmp(argv[1], "record") == 0;
+    const std::string imagedir = argv[2];
+    const std::string goldendir = argv[3];
+    const float tolerance = argc > 4 ? atof(argv[4]) : 1.f;
+
+    std::vector<std::string> paths;
+    list_images(imagedir, "", paths);
+    std::sort(paths.begin(), paths.end());
+
+    if (paths.empty())
+    {
+        fprintf(stderr, "no images in %s\n", imagedir.c_str());
+        return -1;
+    }
+
+    if (!record)
+        fprintf(stdout, "%-10s %6s %6s %8s %9s %9s %9s %13s %13s %17s\n", "model", "images", "faces", "unpaired", "box_dev", "kps_dev", "lmk_dev", "recall g/c", "prec g/c", "ms g/c");
+
+    int failed = 0;
+    for (size_t m = 0; m < sizeof(modeltypes) / sizeof(modeltypes[0]); m++)
+    {
+        const char* modeltype = modeltypes[m];
+
+        if (!file_exists(std::string("scrfd_") + modeltype + "-opt2.param"))
+        {
+            fprintf(stderr, "skip %s, no model files\n", modeltype);
+            continue;
+        }
+
+        const std::string goldenpath = goldendir + "/golden_" + modeltype + ".txt";
+
+        GoldenSet golden;
+        if (!record && load_golden(goldenpath, golden) != 0)
+        {
+            fprintf(stderr, "skip %s, no golden file %s\n", modeltype, goldenpath.c_str());
+            continue;
+        }
+
+        GoldenSet current;
+        if (run_model(modeltype, imagedir, paths, current) != 0)
+            return -1;
+
+        if (record)
+        {
+            if (save_golden(goldenpath, current) != 0)
+                return -1;
+
+            fprintf(stderr, "%s %d images %.2f ms -> %s\n", modeltype, (int)paths.size(), current.avg_ms, goldenpath.c_str());
+            continue;
+        }
+
+        if (golden.images.size() != current.images.size())
+        {
+            fprintf(stderr, "%s golden has %d images, imagedir has %d\n", modeltype, (int)golden.images.size(), (int)current.images.size());
+            failed++;
+            continue;
+        }
+
+        failed += check_model(modeltype, imagedir, golden, current, tolerance);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+// replay a recorded camera stream through the same on_image path the app runs
+// nv21 crop, rgb convert, detect in sensor orientation, rotate to the window, draw and rgba expansion all happen as on device
+//
+// usage: scrfdreplay <modeltype> <file> [orientation] [facing] [fps] [width] [height]
+//   file        = .y4m (4:2:0) or raw nv21 frames, raw needs width and height
+//   orientation = sensor orientation of the recording, 0 90 180 270
+//   facing      = 0 front, 1 back
+//   fps         = playback rate, 0 runs as fast as possible
+// run in the directory holding scrfd_*-opt2.param/bin and 2d106det_change.param/bin
+//
+// eg. ffmpeg -i clip.mp4 -pix_fmt yuv420p clip.y4m && scrfdreplay 500m_kps clip.y4m 270 0
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <benchmark.h>
+
+#include "metrics.h"
+#include "replaysource.h"
+#include "scrfd.h"
+#include "trace.h"
+
+class ScrfdReplay : public ReplayWindow
+{
+public:
+    ScrfdReplay() : scrfd(0), faces(0)
+    {
+    }
+
+    virtual ~ScrfdReplay()
+    {
+        close();
+    }
+
+    virtual void on_image_sensor(const cv::Mat& rgb, int rotate_type) const
+    {
+        scrfd->detect(rgb, rotate_type, result);
+
+        faces += result.face_count();
+    }
+
+    virtual void on_image_render(cv::Mat& rgb, int render_rotate_type) const
+    {
+        MetricTimer timer(METRIC_DRAW);
+        SCRFD_TRACE_SCOPE("draw");
+        scrfd->draw_overlay(rgb, result, render_rotate_type);
+    }
+
+public:
+    SCRFD* scrfd;
+    mutable int faces;
+
+private:
+    mutable FrameResult result;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <modeltype> <file> [orientation] [facing] [fps] [width] [height]\n", argv[0]);
+        return -1;
+    }
+
+    const char* modeltype = argv[1];
+    const char* path = argv[2];
+    int orientation = argc > 3 ? atoi(argv[3]) : 0;
+    int facing = argc > 4 ? atoi(argv[4]) : 0;
+    float fps = argc > 5 ? (float)atof(argv[5]) : 0.f;
+    int width = argc > 6 ? atoi(argv[6]) : 0;
+    int height = argc > 7 ? atoi(argv[7]) : 0;
+
+    SCRFD scrfd;
+    scrfd.load(modeltype);
+
+    ScrfdReplay replay;
+    replay.scrfd = &scrfd;
+    replay.camera_facing = facing;
+    replay.camera_orientation = orientation;
+    replay.fps = fps;
+
+    if (replay.load(path, width, height) != 0)
+        return -1;
+
+    double start = ncnn::get_current_time();
+
+    int frames = replay.run();
+
+    double end = ncnn::get_current_time();
+
+    if (frames <= 0)
+    {
+        fprintf(stderr, "no frame replayed from %s\n", path);
+        return -1;
+    }
+
+    const double total_ms = end - start;
+    fprintf(stderr, "frames %d  faces %d  window %dx%d\n", frames, replay.faces, replay.window.cols, replay.window.rows);
+    fprintf(stderr, "total %.2f ms  %.2f frames/s\n", total_ms, frames * 1000.0 / total_ms);
+
+    MetricsSnapshot snapshot;
+    metrics_snapshot(snapshot);
+    metrics_print(snapshot, stderr);
+
+#if SCRFD_TRACE
+    if (trace_dump("scrfdreplay.trace.json") == 0)
+        fprintf(stderr, "trace written to scrfdreplay.trace.json\n");
+#endif // SCRFD_TRACE
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+// compare every simd backend this cpu supports against the scalar kernels on random inputs
+// selection, iou and pixel kernels must match exactly, the float ones to a relative 1e-5
+// prints one line per backend and kernel, exits non-zero on any mismatch
+//
+// usage: simdcheck [rounds]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "simdkernels.h"
+
+static float frand()
+{
+    return rand() / (float)RAND_MAX;
+}
+
+static bool near(float a, float b)
+{
+    return fabsf(a - b) <= 1e-5f * std::max(1.f, std::max(fabsf(a), fabsf(b)));
+}
+
+static int check_rgb_to_rgba(const SimdKernels& ref, const SimdKernels& k)
+{
+    for (int n = 0; n < 100; n++)
+    {
+        std::vector<unsigned char> rgb(n * 3 + 1);
+        for (size_t i = 0; i < rgb.size(); i++)
+            rgb[i] = rand() % 256;
+
+        // one guard byte past the end
+        std::vector<unsigned char> rgba0(n * 4 + 1, 7);
+        std::vector<unsigned char> rgba1(n * 4 + 1, 7);
+        ref.rgb_to_rgba(rgb.data(), rgba0.data(), n);
+        k.rgb_to_rgba(rgb.data(), rgba1.data(), n);
+
+        if (rgba0 != rgba1)
+        {
+            fprintf(stderr, "rgb_to_rgba n=%d differs\n", n);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int check_select_scores(const SimdKernels& ref, const SimdKernels& k)
+{
+    for (int n = 0; n < 300; n += 7)
+    {
+        std::vector<float> scores(n);
+        for (int i = 0; i < n; i++)
+            scores[i] = frand();
+
+        // exact ties and nan
+        if (n > 3)
+        {
+            scores[1] = 0.5f;
+            scores[2] = NAN;
+        }
+
+        std::vector<int> indices0(n + 1);
+        std::vector<int> indices1(n + 1);
+        int count0 = ref.select_scores(scores.data(), n, 0.5f, indices0.data());
+        int count1 = k.select_scores(scores.data(), n, 0.5f, indices1.data());
+
+        if (count0 != count1 || memcmp(indices0.data(), indices1.data(), count0 * sizeof(int)) != 0)
+        {
+            fprintf(stderr, "select_scores n=%d differs, count %d vs %d\n", n, count0, count1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int check_decode_boxes(const SimdKernels& ref, const SimdKernels& k)
+{
+    const int w = 80;
+    const int size = w * 80;
+
+    std::vector<float> planes(size * 4);
+    for (int i = 0; i < size * 4; i++)
+        planes[i] = frand() * 4;
+
+    const float* bbox[4] = {&planes[0], &planes[size], &planes[size * 2], &planes[size * 3]};
+
+    for (int n = 0; n < 64; n++)
+    {
+        std::vector<int> indices(n);
+        for (int i = 0; i < n; i++)
+            indices[i] = rand() % size;
+
+        std::vector<float> boxes0(n * 4);
+        std::vector<float> boxes1(n * 4);
+        ref.decode_boxes(bbox, indices.data(), n, w, 7.5f, 7.5f, 8.f, boxes0.data());
+        k.decode_boxes(bbox, indices.data(), n, w, 7.5f, 7.5f, 8.f, boxes1.data());
+
+        for (int i = 0; i < n * 4; i++)
+        {
+            if (!near(boxes0[i], boxes1[i]))
+            {
+                fprintf(stderr, "decode_boxes n=%d [%d] %f vs %f\n", n, i, boxes0[i], boxes1[i]);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int check_iou_any_above(const SimdKernels& ref, const SimdKernels& k)
+{
+    const int n = 64;
+
+    std::vector<float> x0(n), y0(n), x1(n), y1(n), areas(n);
+
+    for (int round = 0; round < 2000; round++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            x0[i] = frand() * 200;
+            y0[i] = frand() * 200;
+            x1[i] = x0[i] + 10 + frand() * 60;
+            y1[i] = y0[i] + 10 + frand() * 60;
+            areas[i] = (x1[i] - x0[i]) * (y1[i] - y0[i]);
+        }
+
+        float box[4];
+        box[0] = frand() * 200;
+        box[1] = frand() * 200;
+        box[2] = box[0] + 10 + frand() * 60;
+        box[3] = box[1] + 10 + frand() * 60;
+        const float area = (box[2] - box[0]) * (box[3] - box[1]);
+
+        // every prefix length, so all tails are covered
+        const int count = round % (n + 1);
+        int r0 = ref.iou_any_above(x0.data(), y0.data(), x1.data(), y1.data(), areas.data(), count, box, area, 0.3f);
+        int r1 = k.iou_any_above(x0.data(), y0.data(), x1.data(), y1.data(), areas.data(), count, box, area, 0.3f);
+
+        if (r0 != r1)
+        {
+            fprintf(stderr, "iou_any_above round=%d n=%d %d vs %d\n", round, count, r0, r1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int check_affine_points(const SimdKernels& ref, const SimdKernels& k)
+{
+    const float m[6] = {0.83f, -0.12f, 37.5f, 0.12f, 0.83f, -4.25f};
+
+    for (int n = 0; n < 120; n++)
+    {
+        std::vector<float> xy(n * 2);
+        for (int i = 0; i < n * 2; i++)
+            xy[i] = frand() * 2 - 1;
+
+        std::vector<float> out0(n * 2 + 1, 7.f);
+        std::vector<float> out1(n * 2 + 1, 7.f);
+        ref.affine_points(xy.data(), n, 96.f, m, out0.data());
+        k.affine_points(xy.data(), n, 96.f, m, out1.data());
+
+        for (int i = 0; i < n * 2 + 1; i++)
+        {
+            if (!near(out0[i], out1[i]))
+            {
+                fprintf(stderr, "affine_points n=%d [%d] %f vs %f\n", n, i, out0[i], out1[i]);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const int rounds = argc > 1 ? atoi(argv[1]) : 10;
+
+    const SimdKernels& ref = *simd_backend_kernels(SIMD_SCALAR);
+
+    fprintf(stderr, "best backend %s\n", simd_backend_kernels(simd_best_backend())->name);
+
+    int failed = 0;
+    for (int backend = SIMD_SCALAR + 1; backend < SIMD_BACKEND_COUNT; backend++)
+    {
+        const SimdKernels* k = simd_backend_kernels(backend);
+        if (!k)
+            continue;
+
+        static const char* names[5] = {"rgb_to_rgba", "select_scores", "decode_boxes", "iou_any_above", "affine_points"};
+        int (*checks[5])(const SimdKernels&, const SimdKernels&) = {check_rgb_to_rgba, check_select_scores, check_decode_boxes, check_iou_any_above, check_affine_points};
+
+        for (int c = 0; c < 5; c++)
+        {
+            srand(c);
+
+            int ret = 0;
+            for (int r = 0; r < rounds && ret == 0; r++)
+                ret = checks[c](ref, *k);
+
+            fprintf(stdout, "%s %s %s\n", k->name, names[c], ret == 0 ? "ok" : "FAILED");
+            if (ret != 0)
+                failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
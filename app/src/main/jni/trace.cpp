@@ -0,0 +1,137 @@
+#include "trace.h"
+
+#if SCRFD_TRACE
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define TRACE_RING_SIZE 16384
+
+struct TraceEvent
+{
+    const char* name;
+    long long start_us;
+    long long dur_us;
+};
+
+struct TraceRing
+{
+    int tid;
+    // total events ever written, the ring holds the last TRACE_RING_SIZE
+    std::atomic<unsigned int> head;
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+// rings outlive their threads so a dump still sees events of finished threads
+static std::mutex g_rings_lock;
+static std::vector<TraceRing*> g_rings;
+
+static thread_local TraceRing* t_ring = 0;
+
+static long long now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+static TraceRing* current_ring()
+{
+    if (!t_ring)
+    {
+        TraceRing* ring = new TraceRing;
+        ring->tid = (int)syscall(SYS_gettid);
+        ring->head.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> g(g_rings_lock);
+        g_rings.push_back(ring);
+        t_ring = ring;
+    }
+
+    return t_ring;
+}
+
+TraceScope::TraceScope(const char* _name) : name(_name), start_us(now_us())
+{
+}
+
+TraceScope::~TraceScope()
+{
+    TraceRing* ring = current_ring();
+
+    const unsigned int head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& e = ring->events[head % TRACE_RING_SIZE];
+    e.name = name;
+    e.start_us = start_us;
+    e.dur_us = now_us() - start_us;
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+int trace_dump(const char* path)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+        return -1;
+
+    const int pid = (int)getpid();
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> g(g_rings_lock);
+
+        for (size_t i = 0; i < g_rings.size(); i++)
+        {
+            const TraceRing* ring = g_rings[i];
+
+            const unsigned int head = ring->head.load(std::memory_order_acquire);
+            const unsigned int count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+
+            for (unsigned int j = head - count; j != head; j++)
+            {
+                const TraceEvent& e = ring->events[j % TRACE_RING_SIZE];
+
+                fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}", first ? "" : ",\n", e.name, pid, ring->tid, e.start_us, e.dur_us);
+                first = false;
+            }
+        }
+    }
+
+    fprintf(fp, "\n]}\n");
+
+    int ret = ferror(fp) ? -1 : 0;
+    fclose(fp);
+
+    return ret;
+}
+
+void trace_clear()
+{
+    std::lock_guard<std::mutex> g(g_rings_lock);
+
+    for (size_t i = 0; i < g_rings.size(); i++)
+    {
+        g_rings[i]->head.store(0, std::memory_order_release);
+    }
+}
+
+#else // SCRFD_TRACE
+
+int trace_dump(const char* /*path*/)
+{
+    return -1;
+}
+
+void trace_clear()
+{
+}
+
+#endif // SCRFD_TRACE
@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// chrome trace events for the capture to display pipeline
+// build with -DSCRFD_TRACE=ON, otherwise every SCRFD_TRACE_SCOPE compiles to nothing
+// each thread records into its own ring of the last 16384 events
+// load the dump in chrome://tracing or ui.perfetto.dev
+
+// write all recorded events as chrome trace json, -1 when tracing is compiled out or on io error
+// events recorded during the dump may be torn, dump while the pipeline is idle for a clean trace
+int trace_dump(const char* path);
+
+// drop all recorded events
+void trace_clear();
+
+#if SCRFD_TRACE
+
+class TraceScope
+{
+public:
+    // name must be a string literal, it is stored by pointer
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+private:
+    const char* name;
+    long long start_us;
+};
+
+#define SCRFD_TRACE_CONCAT2(a, b) a##b
+#define SCRFD_TRACE_CONCAT(a, b) SCRFD_TRACE_CONCAT2(a, b)
+#define SCRFD_TRACE_SCOPE(name) TraceScope SCRFD_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else // SCRFD_TRACE
+
+#define SCRFD_TRACE_SCOPE(name)
+
+#endif // SCRFD_TRACE
+
+#endif // TRACE_H